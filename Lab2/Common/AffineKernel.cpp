@@ -0,0 +1,185 @@
+#include "Common/AffineKernel.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define AFFINE_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(AFFINE_X86) && defined(__GNUC__)
+#define AFFINE_TARGET(t) __attribute__((target(t)))
+#else
+#define AFFINE_TARGET(t)
+#endif
+
+using namespace TinyGeom;
+
+typedef void (*AffineFn)(const Affine::Map*, int, const double*, const double*, int,
+	double* const*, double* const*);
+
+Affine::Map Affine::fromMat3(const Mat3& m) {
+	Map ret;
+	ret.a = m[0][0];
+	ret.b = m[0][1];
+	ret.c = m[1][0];
+	ret.d = m[1][1];
+	ret.e = m[2][0];
+	ret.f = m[2][1];
+	return ret;
+}
+
+Affine::Map Affine::compose(const Map& M, const Map& m) {
+	Map ret;
+	ret.a = M.a * m.a + M.c * m.b;
+	ret.b = M.b * m.a + M.d * m.b;
+	ret.c = M.a * m.c + M.c * m.d;
+	ret.d = M.b * m.c + M.d * m.d;
+	ret.e = M.a * m.e + M.c * m.f + M.e;
+	ret.f = M.b * m.e + M.d * m.f + M.f;
+	return ret;
+}
+
+// used when nothing wider is available
+static void applyScalar(const Affine::Map* maps, int k, const double* xs, const double* ys,
+	int n, double* const* oxs, double* const* oys) {
+	for (int j = 0; j < n; j++) {
+		double x = xs[j], y = ys[j];
+		for (int m = 0; m < k; m++) {
+			const Affine::Map& M = maps[m];
+			oxs[m][j] = M.a * x + M.c * y + M.e;
+			oys[m][j] = M.b * x + M.d * y + M.f;
+		}
+	}
+}
+
+#ifdef AFFINE_X86
+
+#define AFFINE_MAX_LANES 4
+
+// The last n-from (< lanes) vertices go through the vector kernel as well,
+// padded out to a full register in scratch space.  Using the same
+// arithmetic for every vertex keeps the results bit-identical however the
+// buffer was split between threads.
+static void applyTail(AffineFn fn, const Affine::Map* maps, int k, const double* xs,
+	const double* ys, int from, int n, double* const* oxs, double* const* oys) {
+	double tx[AFFINE_MAX_LANES] = { 0 }, ty[AFFINE_MAX_LANES] = { 0 };
+	int rem = n - from;
+	for (int j = 0; j < rem; j++) {
+		tx[j] = xs[from + j];
+		ty[j] = ys[from + j];
+	}
+	for (int m = 0; m < k; m++) {
+		double ox[AFFINE_MAX_LANES], oy[AFFINE_MAX_LANES];
+		double* pox = ox;
+		double* poy = oy;
+		fn(maps + m, 1, tx, ty, AFFINE_MAX_LANES, &pox, &poy);
+		for (int j = 0; j < rem; j++) {
+			oxs[m][from + j] = ox[j];
+			oys[m][from + j] = oy[j];
+		}
+	}
+}
+
+static void applySSE2(const Affine::Map* maps, int k, const double* xs, const double* ys,
+	int n, double* const* oxs, double* const* oys) {
+	int j = 0;
+	for (; j + 2 <= n; j += 2) {
+		__m128d x = _mm_loadu_pd(xs + j);
+		__m128d y = _mm_loadu_pd(ys + j);
+		for (int m = 0; m < k; m++) {
+			const Affine::Map& M = maps[m];
+			__m128d ox = _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(M.a)),
+				_mm_mul_pd(y, _mm_set1_pd(M.c))), _mm_set1_pd(M.e));
+			__m128d oy = _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(M.b)),
+				_mm_mul_pd(y, _mm_set1_pd(M.d))), _mm_set1_pd(M.f));
+			_mm_storeu_pd(oxs[m] + j, ox);
+			_mm_storeu_pd(oys[m] + j, oy);
+		}
+	}
+	if (j < n)
+		applyTail(applySSE2, maps, k, xs, ys, j, n, oxs, oys);
+}
+
+AFFINE_TARGET("avx2,fma")
+static void applyAVX2(const Affine::Map* maps, int k, const double* xs, const double* ys,
+	int n, double* const* oxs, double* const* oys) {
+	int j = 0;
+	for (; j + 4 <= n; j += 4) {
+		__m256d x = _mm256_loadu_pd(xs + j);
+		__m256d y = _mm256_loadu_pd(ys + j);
+		for (int m = 0; m < k; m++) {
+			const Affine::Map& M = maps[m];
+			__m256d ox = _mm256_fmadd_pd(x, _mm256_set1_pd(M.a),
+				_mm256_fmadd_pd(y, _mm256_set1_pd(M.c), _mm256_set1_pd(M.e)));
+			__m256d oy = _mm256_fmadd_pd(x, _mm256_set1_pd(M.b),
+				_mm256_fmadd_pd(y, _mm256_set1_pd(M.d), _mm256_set1_pd(M.f)));
+			_mm256_storeu_pd(oxs[m] + j, ox);
+			_mm256_storeu_pd(oys[m] + j, oy);
+		}
+	}
+	if (j < n)
+		applyTail(applyAVX2, maps, k, xs, ys, j, n, oxs, oys);
+}
+
+static bool cpuHasAVX2() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	if (!osxsave || !fma) return false;
+	// the os has to save the ymm registers on context switches
+	if ((_xgetbv(0) & 6) != 6) return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+static bool cpuHasSSE2() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+
+#endif
+
+static AffineFn selectKernel(const char** name) {
+#ifdef AFFINE_X86
+	if (cpuHasAVX2()) {
+		*name = "avx2";
+		return applyAVX2;
+	}
+	if (cpuHasSSE2()) {
+		*name = "sse2";
+		return applySSE2;
+	}
+#endif
+	*name = "scalar";
+	return applyScalar;
+}
+
+static const char* s_kernelName = NULL;
+static AffineFn s_kernel = selectKernel(&s_kernelName);
+
+void Affine::applyMaps(const Map* maps, int k, const double* xs, const double* ys, int n,
+	double* const* oxs, double* const* oys) {
+	if (k <= 0 || n <= 0) return;
+	s_kernel(maps, k, xs, ys, n, oxs, oys);
+}
+
+const char* Affine::kernelName() {
+	return s_kernelName;
+}
@@ -0,0 +1,35 @@
+#ifndef AFFINE_KERNEL_H
+#define AFFINE_KERNEL_H
+
+#include "Common/TinyGeom.h"
+
+// Batched application of several affine maps to one vertex buffer.
+// Vertices are given as separate x and y arrays; every map writes its own
+// output arrays.  The vector width (AVX2+FMA, SSE2 or plain scalar) is
+// picked once at runtime from what the cpu supports.
+namespace Affine {
+	// the affine part of a row-vector Mat3:
+	//   x' = a*x + c*y + e
+	//   y' = b*x + d*y + f
+	struct Map {
+		double a, b, c, d, e, f;
+	};
+
+	Map fromMat3(const TinyGeom::Mat3& m);
+
+	// the map p -> outer(inner(p))
+	Map compose(const Map& outer, const Map& inner);
+
+	inline TinyGeom::Pt2 apply(const Map& M, const TinyGeom::Pt2& p) {
+		return TinyGeom::Pt2(M.a * p[0] + M.c * p[1] + M.e, M.b * p[0] + M.d * p[1] + M.f);
+	}
+
+	// for every m < k: (oxs[m][j],oys[m][j]) = maps[m] applied to (xs[j],ys[j]), j < n
+	void applyMaps(const Map* maps, int k, const double* xs, const double* ys, int n,
+		double* const* oxs, double* const* oys);
+
+	// name of the kernel applyMaps dispatches to: "avx2", "sse2" or "scalar"
+	const char* kernelName();
+}
+
+#endif
@@ -0,0 +1,40 @@
+#include "Common/AllocStats.h"
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+using namespace std;
+
+static atomic<long long> allocCount(0);
+static atomic<long long> allocBytes(0);
+
+long long AllocStats::count() {
+	return allocCount.load(memory_order_relaxed);
+}
+
+long long AllocStats::bytes() {
+	return allocBytes.load(memory_order_relaxed);
+}
+
+void* operator new(size_t n) {
+	allocCount.fetch_add(1, memory_order_relaxed);
+	allocBytes.fetch_add((long long)n, memory_order_relaxed);
+	void* p = malloc(n ? n : 1);
+	if (!p) throw bad_alloc();
+	return p;
+}
+void* operator new[](size_t n) { return operator new(n); }
+void* operator new(size_t n, const nothrow_t&) noexcept {
+	try { return operator new(n); }
+	catch (...) { return NULL; }
+}
+void* operator new[](size_t n, const nothrow_t&) noexcept {
+	try { return operator new(n); }
+	catch (...) { return NULL; }
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { free(p); }
@@ -0,0 +1,14 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+// Linking AllocStats.cpp replaces the global operator new and delete with
+// versions that count every heap allocation of the process, from any
+// thread, for the benchmarks and the viewers' overlay.
+namespace AllocStats {
+	// operator new calls so far
+	long long count();
+	// bytes asked for so far
+	long long bytes();
+}
+
+#endif
@@ -1,7 +1,7 @@
 #ifndef COMMON_H
 #define COMMON_H
 
-#include <Fl/Fl.H>
+#include <FL/Fl.H>
 #include <string> 
 #include <vector>
 #include <sstream> 
@@ -4,6 +4,7 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <string>
 #include <cassert>
 #include <iostream>
@@ -17,169 +18,113 @@ using namespace std;
 #endif
 
 
-template <class t, int n> class Vector;
-template <class Type, int N>
-class Matrix
+/*
+ * Compile-time unrolled kernels.  Every loop bound below is a template
+ * parameter, so for the 3x3 (and 4x4) matrices used by TinyGeom the
+ * compiler emits straight-line code with no loop control at all.
+ */
+template <class Type, int N, int K>
+struct MatUnroll
 {
-protected:
-	int rows, cols;
-	Type** data;
-
-
-public:
-	Matrix() : rows(N), cols(N), data(NULL) {
-		data = new Type * [rows];
-		for (int r = 0; r < rows; r++)
-		{
-			data[r] = new Type[cols];
-			memset(data[r], 0, cols * sizeof(Type));
-		}
+	// sum_{k<K} L[i][k] * R[k][j]
+	static inline Type dot(const Type (*L)[N], const Type (*R)[N], int i, int j)
+	{
+		return MatUnroll< Type, N, K - 1 >::dot(L, R, i, j) + L[i][K - 1] * R[K - 1][j];
+	}
 
-		int s = rows < cols ? rows : cols;
-		for (int r = 0; r < s; r++)
-		{
-			data[r][r] = 1;
-		}
+	// sum_{k<K} v[k] * R[k][j]
+	static inline Type vdot(const Type* v, const Type (*R)[N], int j)
+	{
+		return MatUnroll< Type, N, K - 1 >::vdot(v, R, j) + v[K - 1] * R[K - 1][j];
 	}
 
-	Matrix(const Matrix< Type, N >& M)
+	// sum_{k<K} L[i][k] * v[k]
+	static inline Type dotv(const Type (*L)[N], const Type* v, int i)
 	{
-		rows = M.rows;
-		cols = M.cols;
+		return MatUnroll< Type, N, K - 1 >::dotv(L, v, i) + L[i][K - 1] * v[K - 1];
+	}
+};
 
-		data = new Type * [rows];
-		int copySize = sizeof(Type) * cols;
+template <class Type, int N>
+struct MatUnroll< Type, N, 1 >
+{
+	static inline Type dot(const Type (*L)[N], const Type (*R)[N], int i, int j) { return L[i][0] * R[0][j]; }
+	static inline Type vdot(const Type* v, const Type (*R)[N], int j) { return v[0] * R[0][j]; }
+	static inline Type dotv(const Type (*L)[N], const Type* v, int i) { return L[i][0] * v[0]; }
+};
 
-		for (int r = 0; r < rows; r++)
-		{
-			data[r] = new Type[cols];
-			memcpy(data[r], M.data[r], copySize);
-		}
-	}
 
-	virtual ~Matrix()
-	{
-		if (data)
-		{
-			for (int r = 0; r < rows; r++)
-			{
-				CLEAN_ARRAY_DELETE(data[r]);
-			}
-			CLEAN_ARRAY_DELETE(data);
-		}
+template <class t, int n> class Vector;
+template <class Type, int N>
+class Matrix
+{
+protected:
+	// inline storage: a Matrix is a plain N*N block, copying it is a memcpy
+	// and constructing a temporary never touches the heap
+	Type data[N][N];
+
+
+public:
+	Matrix() {
+		identity();
 	}
 
-	Type** Data() { return data; }
+	Type (*Data())[N] { return data; }
+	const Type (*Data() const)[N] { return data; }
 
 	void identity()
 	{
-		int s = rows < cols ? rows : cols;
-		int copySize = cols * sizeof(Type);
-		for (int i = 0; i < rows; i++)
-		{
-			memset(data[i], 0, copySize);
-		}
-		for (int i = 0; i < s; i++)
+		memset(data, 0, sizeof(data));
+		for (int i = 0; i < N; i++)
 		{
 			data[i][i] = 1;
 		}
 	}
 
-	void clean()
-	{
-		if (data)
-		{
-			for (int r = 0; r < rows; r++)
-			{
-				CLEAN_ARRAY_DELETE(data[r]);
-			}
-			CLEAN_ARRAY_DELETE(data);
-		}
-	}
+	// storage is inline, there is nothing to release
+	void clean() { }
 
 	void clear()
 	{
-		for (int r = 0; r < rows; r++)
-		{
-			memset(data[r], 0, cols * sizeof(Type));
-		}
+		memset(data, 0, sizeof(data));
 	}
 
-	int Rows() const { return rows; }
-	int Cols() const { return cols; }
+	int Rows() const { return N; }
+	int Cols() const { return N; }
 
-	void operator = (const Matrix< Type, N >& M)
+	Type* operator[] (int r)
 	{
-		if (data)
-		{
-			for (int r = 0; r < rows; r++)
-			{
-				CLEAN_DELETE(data[r]);
-			}
-			CLEAN_DELETE(data);
-		}
-
-		rows = M.rows;
-		cols = M.cols;
-
-		data = new Type * [rows];
-		for (int r = 0; r < rows; r++)
-		{
-			data[r] = new Type[cols];
-			memcpy(data[r], M.data[r], sizeof(Type) * cols);
-		}
-	}
-
-	Type*& operator[] (int r)
-	{
-		assert(r >= 0 && r < rows);
+		assert(r >= 0 && r < N);
 		return data[r];
 	}
 
-	Type* operator[] (int r) const
+	const Type* operator[] (int r) const
 	{
-		assert(r >= 0 && r < rows);
+		assert(r >= 0 && r < N);
 		return data[r];
 	}
 
 public:
 	/************************* FRIEND FUNCTIONS FOR MATRICES *****************************/
-	friend Matrix< Type, N > operator + (Matrix< Type, N >& L, Matrix< Type, N >& R)
+	friend Matrix< Type, N > operator + (const Matrix< Type, N >& L, const Matrix< Type, N >& R)
 	{
-		assert((L.rows == R.rows) && (L.cols == R.cols));
-		int rows = L.rows;
-		int cols = R.cols;
-
 		Matrix< Type, N > M;
 
-		for (int i = 0; i < rows; i++) {
-			for (int j = 0; j < cols; j++) {
-				M[i][j] = L.data[i][j] + R.data[i][j];
+		for (int i = 0; i < N; i++) {
+			for (int j = 0; j < N; j++) {
+				M.data[i][j] = L.data[i][j] + R.data[i][j];
 			}
 		}
-		//	TODO: fill this in
 		return M;
 	}
 
 	friend Matrix< Type, N > operator * (const Matrix< Type, N >& L, const Matrix< Type, N >& R)
 	{
-		assert(L.cols == R.rows);
-
-		int rows = L.rows;
-		int cols = R.cols;
-
-		int d = L.cols;
-
 		Matrix< Type, N > M;
-		//	TODO: fill this in
 
-		for (int i = 0; i < rows; i++) {
-			for (int j = 0; j < cols; j++) {
-				Type sum = L.data[i][0] * R.data[0][j];
-				for (int k = 1; k < d; k++) {
-					sum = sum + (L.data[i][k] * R.data[k][j]);
-				}
-				M[i][j] = sum;
+		for (int i = 0; i < N; i++) {
+			for (int j = 0; j < N; j++) {
+				M.data[i][j] = MatUnroll< Type, N, N >::dot(L.data, R.data, i, j);
 			}
 		}
 
@@ -188,15 +133,12 @@ public:
 
 	friend Matrix< Type, N > operator * (Type alpha, const Matrix< Type, N >& R)
 	{
-		int rows = R.rows;
-		int cols = R.cols;
-
 		Matrix< Type, N > M;
-		for (int r = 0; r < rows; r++)
+		for (int r = 0; r < N; r++)
 		{
-			for (int c = 0; c < cols; c++)
+			for (int c = 0; c < N; c++)
 			{
-				M[r][c] = alpha * R.data[r][c];
+				M.data[r][c] = alpha * R.data[r][c];
 			}
 		}
 
@@ -205,32 +147,17 @@ public:
 
 	friend Matrix< Type, N > operator * (const Matrix< Type, N >& L, Type alpha)
 	{
-		int rows = L.rows;
-		int cols = L.cols;
-
-		Matrix< Type, N > M;
-		for (int r = 0; r < rows; r++)
-		{
-			for (int c = 0; c < cols; c++)
-			{
-				M[r][c] = alpha * L.data[r][c];
-			}
-		}
-
-		return M;
+		return alpha * L;
 	}
 
 	friend Matrix< Type, N > operator - (const Matrix< Type, N >& R)
 	{
-		int rows = R.rows;
-		int cols = R.cols;
-
 		Matrix< Type, N > M;
-		for (int r = 0; r < rows; r++)
+		for (int r = 0; r < N; r++)
 		{
-			for (int c = 0; c < cols; c++)
+			for (int c = 0; c < N; c++)
 			{
-				M[r][c] = -R.data[r][c];
+				M.data[r][c] = -R.data[r][c];
 			}
 		}
 
@@ -239,70 +166,71 @@ public:
 
 	friend Matrix< Type, N > operator - (const Matrix< Type, N >& L, const Matrix< Type, N >& R)
 	{
-		assert((L.rows == R.rows) && (L.cols == R.rows));
-		int rows = L.rows;
-		int cols = R.cols;
-
 		Matrix< Type, N > M;
-		for (int r = 0; r < rows; r++)
+		for (int r = 0; r < N; r++)
 		{
-			for (int c = 0; c < cols; c++)
+			for (int c = 0; c < N; c++)
 			{
-				M[r][c] = L.data[r][c] - R.data[r][c];
+				M.data[r][c] = L.data[r][c] - R.data[r][c];
 			}
 		}
 
 		return M;
 	}
 
-	friend Matrix< Type, N > transpose(Matrix< Type, N > M)
+	friend Matrix< Type, N > transpose(const Matrix< Type, N >& M)
 	{
-		int rows = M.rows;
-		int cols = M.cols;
-
 		Matrix< Type, N > R;
 
-		for (int r = 0; r < rows; r++)
+		for (int r = 0; r < N; r++)
 		{
-			for (int c = 0; c < cols; c++)
+			for (int c = 0; c < N; c++)
 			{
-				R[c][r] = M.data[r][c];
+				R.data[c][r] = M.data[r][c];
 			}
 		}
 		return R;
 	}
 
 	friend Matrix<Type, N> operator !(const Matrix< Type, N >& T) {
-		Matrix< Type, N > M = T;
-		//	TODO: fill this in
-		Type det = determinant(M);
+		Type det = determinant(T);
 		if (det == 0) {
 			std::cout << "ERROR" << endl;
-			return M;
+			return T;
 		}
-		return adjoint(M) * (1 / det);
+		return adjoint(T) * (1 / det);
 	}
 };
 
 
 template <class Type>
-Type determinant(Matrix< Type, 1 > M) {
+Type determinant(const Matrix< Type, 1 >& M) {
 	return M[0][0];
 }
 
+template <class Type>
+Type determinant(const Matrix< Type, 2 >& M) {
+	return M[0][0] * M[1][1] - M[0][1] * M[1][0];
+}
+
+template <class Type>
+Type determinant(const Matrix< Type, 3 >& M) {
+	return M[0][0] * (M[1][1] * M[2][2] - M[1][2] * M[2][1])
+		- M[0][1] * (M[1][0] * M[2][2] - M[1][2] * M[2][0])
+		+ M[0][2] * (M[1][0] * M[2][1] - M[1][1] * M[2][0]);
+}
+
 template <class Type, int N>
-Type determinant(Matrix< Type, N > M) {
-	if (N == 1)return M[0][0];
+Type determinant(const Matrix< Type, N >& M) {
 	Type det = 0;
-	int rows = N, cols = N;
 	int sign = -1;
-	for (int c = 0; c < cols; c++)
+	for (int c = 0; c < N; c++)
 	{
 		sign *= (-1);
 		Matrix< Type, N - 1 > A;
-		for (int rr = 0; rr < rows - 1; rr++)
+		for (int rr = 0; rr < N - 1; rr++)
 		{
-			for (int cc = 0; cc < cols - 1; cc++)
+			for (int cc = 0; cc < N - 1; cc++)
 			{
 				A[rr][cc] = M[rr + 1][cc + (cc >= c)];
 			}
@@ -313,31 +241,48 @@ Type determinant(Matrix< Type, N > M) {
 }
 
 template <class Type>
-Matrix<Type, 1> adjoint(Matrix< Type, 1 > M) {
-	Matrix<Type, 1> adj;
-	adj = M;
+Matrix<Type, 1> adjoint(const Matrix< Type, 1 >& M) {
+	return M;
+}
+
+template <class Type>
+Matrix<Type, 2> adjoint(const Matrix< Type, 2 >& M) {
+	Matrix<Type, 2> adj;
+	adj[0][0] = M[1][1];
+	adj[0][1] = -M[0][1];
+	adj[1][0] = -M[1][0];
+	adj[1][1] = M[0][0];
+	return adj;
+}
+
+// closed-form adjugate for the affine 3x3 case, no minors are built
+template <class Type>
+Matrix<Type, 3> adjoint(const Matrix< Type, 3 >& M) {
+	Matrix<Type, 3> adj;
+	adj[0][0] = M[1][1] * M[2][2] - M[1][2] * M[2][1];
+	adj[0][1] = M[0][2] * M[2][1] - M[0][1] * M[2][2];
+	adj[0][2] = M[0][1] * M[1][2] - M[0][2] * M[1][1];
+	adj[1][0] = M[1][2] * M[2][0] - M[1][0] * M[2][2];
+	adj[1][1] = M[0][0] * M[2][2] - M[0][2] * M[2][0];
+	adj[1][2] = M[0][2] * M[1][0] - M[0][0] * M[1][2];
+	adj[2][0] = M[1][0] * M[2][1] - M[1][1] * M[2][0];
+	adj[2][1] = M[0][1] * M[2][0] - M[0][0] * M[2][1];
+	adj[2][2] = M[0][0] * M[1][1] - M[0][1] * M[1][0];
 	return adj;
 }
 
 template <class Type, int N>
-Matrix<Type, N> adjoint(Matrix< Type, N > M) {
+Matrix<Type, N> adjoint(const Matrix< Type, N >& M) {
 	Matrix<Type, N> adj;
-	if (N == 1) {
-		adj = M;
-		return adj;
-	}
-	Type det = 0;
-	int rows = N, cols = N;
-	int sign = -1;
-	for (int r = 0; r < rows; r++)
+	for (int r = 0; r < N; r++)
 	{
-		for (int c = 0; c < cols; c++)
+		for (int c = 0; c < N; c++)
 		{
-			sign = (r + c) % 2 ? -1 : 1;
+			int sign = (r + c) % 2 ? -1 : 1;
 			Matrix< Type, N - 1 > A;
-			for (int rr = 0; rr < rows - 1; rr++)
+			for (int rr = 0; rr < N - 1; rr++)
 			{
-				for (int cc = 0; cc < cols - 1; cc++)
+				for (int cc = 0; cc < N - 1; cc++)
 				{
 					A[rr][cc] = M[rr + (rr >= r)][cc + (cc >= c)];
 				}
@@ -528,20 +473,13 @@ public:
 
 	friend Vector< Type, n > operator *(const Vector< Type, n >& L, const Matrix< Type, n>& R)
 	{
-		int size = L.size;
-		assert(size == R.Rows());
-
-		int cols = R.Cols();
+		assert(L.size == R.Rows());
 
 		Vector< Type, n > LR;
 
-		for (int c = 0; c < cols; c++)
+		for (int c = 0; c < n; c++)
 		{
-			LR[c] = 0;
-			for (int r = 0; r < size; r++)
-			{
-				LR[c] += L.data[r] * R[r][c];
-			}
+			LR.data[c] = MatUnroll< Type, n, n >::vdot(L.data, R.Data(), c);
 		}
 
 		return LR;
@@ -549,18 +487,13 @@ public:
 
 	friend Vector< Type, n > operator *(const Matrix< Type, n>& L, const Vector< Type, n >& R)
 	{
-		int size = R.size;
-		int rows = L.Rows();
+		assert(R.size == L.Cols());
 
 		Vector< Type, n > LR;
 
-		for (int r = 0; r < rows; r++)
+		for (int r = 0; r < n; r++)
 		{
-			LR[r] = 0;
-			for (int c = 0; c < size; c++)
-			{
-				LR[r] += R.data[c] * L[r][c];
-			}
+			LR.data[r] = MatUnroll< Type, n, n >::dotv(L.Data(), R.data, r);
 		}
 
 		return LR;
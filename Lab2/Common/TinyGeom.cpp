@@ -23,7 +23,7 @@ Tri2::Tri2(const Pt2& c, double r) {
 	for (int j = 0; j < 3; j++) {
 		double dx = cos(degs[j]) * r;
 		double dy = sin(degs[j]) * r;
-		_pts[j] = c + Vec2(dx, dy, 0);
+		_pts[j] = c + Vec2(dx, dy);
 	}
 }
 
@@ -40,7 +40,7 @@ Quad2::Quad2(const Pt2& c, double r) {
 	for (int j = 0; j < 4; j++) {
 		double dx = cos(degs[j]) * r;
 		double dy = sin(degs[j]) * r;
-		_pts[j] = c + Vec2(dx, dy, 0);
+		_pts[j] = c + Vec2(dx, dy);
 	}
 }
 
@@ -58,7 +58,7 @@ Hex2::Hex2(const Pt2& c, double r) {
 	for (int j = 0; j < 6; j++) {
 		double dx = cos(degs[j]) * r;
 		double dy = sin(degs[j]) * r;
-		_pts[j] = c + Vec2(dx, dy, 0);
+		_pts[j] = c + Vec2(dx, dy);
 	}
 }
 
@@ -76,7 +76,7 @@ Oct2::Oct2(const Pt2& c, double r) {
 	for (int j = 0; j < 8; j++) {
 		double dx = cos(degs[j]) * r;
 		double dy = sin(degs[j]) * r;
-		_pts[j] = c + Vec2(dx, dy, 0);
+		_pts[j] = c + Vec2(dx, dy);
 	}
 }
 
@@ -94,7 +94,7 @@ Pent2::Pent2(const Pt2& c, double r) {
 	for (int j = 0; j < 5; j++) {
 		double dx = cos(degs[j]) * r;
 		double dy = sin(degs[j]) * r;
-		_pts[j] = c + Vec2(dx, dy, 0);
+		_pts[j] = c + Vec2(dx, dy);
 	}
 }
 
@@ -108,12 +108,9 @@ Circ2::Circ2() :Geom2() {
 
 Circ2::Circ2(const Pt2& c, double r) {
 	init();
-
-	for (int j = 0; j < size(); j++) {
-		double dx = cos(2 * M_PI / size() * j) * r;
-		double dy = sin(2 * M_PI / size() * j) * r;
-		_pts[j] = c + Vec2(dx, dy, 0);
-	}
+	_pts[0] = c;
+	_pts[1] = c + Vec2(r, 0);
+	_pts[2] = c + Vec2(0, r);
 }
 
 double Utils::cross2d(const Vec2& v, const Vec2& w) {
@@ -127,6 +124,10 @@ double Utils::dist2d(const Pt2& a, const Pt2& b) {
 }
 
 bool Utils::isPtInterior(Geom2* g, const Pt2& p) {
+	if (g->kind() == TG_CIRC) {
+		Circ2* c = (Circ2*)g;
+		return isPtInEllipse(c->center(), c->axisU(), c->axisV(), p);
+	}
 	if (g->size() < 3)
 		return false;
 
@@ -149,6 +150,7 @@ bool Utils::isPtInterior(Geom2* g, const Pt2& p) {
 }
 
 bool Utils::isConvex(Geom2* g) {
+	if (g->kind() == TG_CIRC) return true;
 	if (g->size() < 3) return false;
 
 	for (int j = 0; j < g->size(); j++) {
@@ -166,6 +168,8 @@ bool Utils::isConvex(Geom2* g) {
 }
 
 Pt2 Utils::centroid(Geom2* g) {
+	if (g->kind() == TG_CIRC)
+		return ((Circ2*)g)->center();
 	Pt2 p(0, 0);
 	for (int j = 0; j < g->size(); j++) {
 		p += (*g->get(j));
@@ -173,4 +177,82 @@ Pt2 Utils::centroid(Geom2* g) {
 	if (g->size() > 0)
 		p /= g->size();
 	return p;
-}
\ No newline at end of file
+}
+// same tests as above on a polygon stored as separate x and y arrays
+bool Utils::isPtInterior(const double* xs, const double* ys, int n, const Pt2& p) {
+	if (n < 3)
+		return false;
+
+	double d = (xs[0] - p[0]) * (ys[1] - p[1]) - (ys[0] - p[1]) * (xs[1] - p[0]);
+	int sign = d < 0 ? -1 : 1;
+
+	for (int j = 1; j < n; j++) {
+		int next = (j + 1) % n;
+		d = (xs[j] - p[0]) * (ys[next] - p[1]) - (ys[j] - p[1]) * (xs[next] - p[0]);
+		int nsign = d < 0 ? -1 : 1;
+		if (sign != nsign)
+			return false;
+	}
+
+	return true;
+}
+
+bool Utils::isConvex(const double* xs, const double* ys, int n) {
+	if (n < 3) return false;
+
+	for (int j = 0; j < n; j++) {
+		int a = (j - 1 + n) % n;
+		int b = j;
+		int c = (j + 1) % n;
+
+		Vec2 cb(xs[c] - xs[b], ys[c] - ys[b]);
+		Vec2 ab(xs[a] - xs[b], ys[a] - ys[b]);
+
+		if (cross2d(cb, ab) < 0) return false;
+	}
+
+	return true;
+}
+
+int Utils::ellipseSegments(const Vec2& u, const Vec2& v, double pixel) {
+	if (pixel <= 0) return CIRCLE_MAX_SEGMENTS;
+
+	// semi-major axis, the larger singular value of the matrix [u v]
+	double s = u * u + v * v;
+	double d = cross2d(u, v);
+	double a = sqrt((s + sqrt(max(0., s * s - 4 * d * d))) / 2);
+
+	// a chord over an angle of 2pi/n strays a(1-cos(pi/n)) from the curve
+	double tol = .25 * pixel;
+	if (a <= tol) return CIRCLE_MIN_SEGMENTS;
+	double n = ceil(M_PI / acos(1 - tol / a));
+	return (int)min((double)CIRCLE_MAX_SEGMENTS, max((double)CIRCLE_MIN_SEGMENTS, n));
+}
+
+void Utils::tessellateEllipse(const Pt2& c, const Vec2& u, const Vec2& v, int n, double* xs, double* ys) {
+	for (int j = 0; j < n; j++) {
+		double t = 2 * M_PI / n * j;
+		double ct = cos(t), st = sin(t);
+		xs[j] = c[0] + ct * u[0] + st * v[0];
+		ys[j] = c[1] + ct * u[1] + st * v[1];
+	}
+}
+
+bool Utils::isPtInEllipse(const Pt2& c, const Vec2& u, const Vec2& v, const Pt2& p) {
+	// p - c = q0 u + q1 v, inside if q is in the unit circle
+	double d = cross2d(u, v);
+	if (d == 0) return false;
+	Vec2 w = p - c;
+	double q0 = cross2d(w, v) / d;
+	double q1 = cross2d(u, w) / d;
+	return q0 * q0 + q1 * q1 <= 1;
+}
+
+void Utils::ellipseBounds(const Pt2& c, const Vec2& u, const Vec2& v, double* b) {
+	double hx = sqrt(u[0] * u[0] + v[0] * v[0]);
+	double hy = sqrt(u[1] * u[1] + v[1] * v[1]);
+	b[0] = c[0] - hx;
+	b[1] = c[1] - hy;
+	b[2] = c[0] + hx;
+	b[3] = c[1] + hy;
+}
@@ -5,21 +5,65 @@
 #include "Common/Matrix.h" 
 
 namespace TinyGeom {
-	const int CIRCLE_SIZE = 100;
-	typedef Vector3D Pt2; // use 3d vector for affine transform 
-	typedef Pt2 Vec2;
+	// segments of a drawn circle, see Utils::ellipseSegments
+	const int CIRCLE_MIN_SEGMENTS = 8;
+	const int CIRCLE_MAX_SEGMENTS = 256;
 	typedef Vector4D Color;
 
 	typedef Matrix<double, 3> Mat3;
+
+	// compact 2d point, trivially copyable: just x and y, the homogeneous
+	// coordinate is implicitly 1 when it goes through a Mat3
+	struct Pt2 {
+		double x, y;
+
+		Pt2() : x(0), y(0) {}
+		Pt2(double px, double py) : x(px), y(py) {}
+		explicit Pt2(const Vector3D& v) : x(v[0]), y(v[1]) {}
+
+		Vector3D toVector() const { return Vector3D(x, y, 1); }
+
+		inline double& operator[] (int i) { return i ? y : x; }
+		inline double operator[] (int i) const { return i ? y : x; }
+
+		void operator += (const Pt2& p) { x += p.x; y += p.y; }
+		void operator -= (const Pt2& p) { x -= p.x; y -= p.y; }
+		void operator *= (double a) { x *= a; y *= a; }
+		void operator /= (double a) { x /= a; y /= a; }
+
+		void normalize() {
+			double m = sqrt(x * x + y * y);
+			if (m != 0) { x /= m; y /= m; }
+		}
+
+		friend Pt2 operator + (const Pt2& l, const Pt2& r) { return Pt2(l.x + r.x, l.y + r.y); }
+		friend Pt2 operator - (const Pt2& l, const Pt2& r) { return Pt2(l.x - r.x, l.y - r.y); }
+		friend Pt2 operator - (const Pt2& p) { return Pt2(-p.x, -p.y); }
+		friend Pt2 operator * (double a, const Pt2& p) { return Pt2(a * p.x, a * p.y); }
+		friend Pt2 operator * (const Pt2& p, double a) { return Pt2(a * p.x, a * p.y); }
+		friend double operator * (const Pt2& l, const Pt2& r) { return l.x * r.x + l.y * r.y; }
+		friend double mag(const Pt2& p) { return sqrt(p.x * p.x + p.y * p.y); }
+
+		// row vector (x,y,1) times an affine matrix
+		friend Pt2 operator * (const Pt2& p, const Mat3& m) {
+			return Pt2(p.x * m[0][0] + p.y * m[1][0] + m[2][0],
+				p.x * m[0][1] + p.y * m[1][1] + m[2][1]);
+		}
+	};
+	typedef Pt2 Vec2;
 	class Geom2Visitor;
 
+	// TODO: need to TGShape enum needs to be expanded for addtional shapes
+	enum TGShape { TG_TRIANGLE, TG_QUAD, TG_HEX, TG_OCT, TG_CIRC, TG_PENT };
+
 	class Geom2 {
 	protected:
 		Pt2* _pts;
 	public:
 		Geom2() { _pts = NULL; }
-		~Geom2() { delete[] _pts; }
+		virtual ~Geom2() { delete[] _pts; }
 		virtual int size() const = 0;
+		virtual TGShape kind() const = 0;
 		virtual Pt2* get(int i) { return &_pts[i]; }
 		const Pt2* get(int i) const { return &_pts[i]; }
 		virtual void init() { _pts = new Pt2[this->size()]; }
@@ -41,6 +85,7 @@ namespace TinyGeom {
 
 	class Geom2Visitor {
 	public:
+		virtual ~Geom2Visitor() {}
 		virtual void visit(Tri2* geom, void* data) = 0;
 		virtual void visit(Quad2* geom, void* data) = 0;
 		virtual void visit(Hex2* geom, void* data) = 0;
@@ -54,14 +99,22 @@ namespace TinyGeom {
 	class Utils {
 	public:
 		static bool isPtInterior(Geom2* g, const Pt2& p);
+		static bool isPtInterior(const double* xs, const double* ys, int n, const Pt2& p);
 		static bool isConvex(Geom2* g);
+		static bool isConvex(const double* xs, const double* ys, int n);
 		static double cross2d(const Vec2& v, const Vec2& w);
 		static double dist2d(const Pt2& a, const Pt2& b);
 		static Pt2 centroid(Geom2* g);
-	};
 
-	// TODO: need to TGShape enum needs to be expanded for addtional shapes
-	enum TGShape { TG_TRIANGLE, TG_QUAD, TG_HEX, TG_OCT, TG_CIRC, TG_PENT };
+		// the ellipse c + cos(t) u + sin(t) v of a Circ2.  ellipseSegments is
+		// the number of outline vertices that keeps every chord within a
+		// quarter pixel of the curve.
+		static int ellipseSegments(const Vec2& u, const Vec2& v, double pixel);
+		static void tessellateEllipse(const Pt2& c, const Vec2& u, const Vec2& v, int n, double* xs, double* ys);
+		static bool isPtInEllipse(const Pt2& c, const Vec2& u, const Vec2& v, const Pt2& p);
+		// box (minx,miny,maxx,maxy) around the ellipse
+		static void ellipseBounds(const Pt2& c, const Vec2& u, const Vec2& v, double* b);
+	};
 
 	class Tri2 : public Geom2 {
 	public:
@@ -70,6 +123,7 @@ namespace TinyGeom {
 		Tri2(const Pt2& c, double r);
 
 		virtual int size() const { return 3; }
+		virtual TGShape kind() const { return TG_TRIANGLE; }
 
 		virtual void accept(Geom2Visitor* visitor, void* data) {
 			visitor->visit(this, data);
@@ -82,6 +136,7 @@ namespace TinyGeom {
 		Quad2(const Pt2& c, double r);
 
 		virtual int size() const { return 4; }
+		virtual TGShape kind() const { return TG_QUAD; }
 
 		virtual void accept(Geom2Visitor* visitor, void* data) {
 			visitor->visit(this, data);
@@ -94,6 +149,7 @@ namespace TinyGeom {
 		Hex2(const Pt2& c, double r);
 
 		virtual int size() const { return 6; }
+		virtual TGShape kind() const { return TG_HEX; }
 
 		virtual void accept(Geom2Visitor* visitor, void* data) {
 			visitor->visit(this, data);
@@ -106,6 +162,7 @@ namespace TinyGeom {
 		Oct2(const Pt2& c, double r);
 
 		virtual int size() const { return 8; }
+		virtual TGShape kind() const { return TG_OCT; }
 
 		virtual void accept(Geom2Visitor* visitor, void* data) {
 			visitor->visit(this, data);
@@ -118,18 +175,28 @@ namespace TinyGeom {
 		Pent2(const Pt2& c, double r);
 
 		virtual int size() const { return 5; }
+		virtual TGShape kind() const { return TG_PENT; }
 
 		virtual void accept(Geom2Visitor* visitor, void* data) {
 			visitor->visit(this, data);
 		}
 	};
 
+	// a circle, or an ellipse once transformed, kept as three points: the
+	// centre c and the images c+u and c+v of (1,0) and (0,1) on the unit
+	// circle.  An affine map moves the three points exactly, so the outline
+	// is only tessellated when it is drawn.
 	class Circ2 : public Geom2 {
 	public:
 		Circ2();
 		Circ2(const Pt2& c, double r);
 
-		virtual int size() const { return CIRCLE_SIZE; }
+		virtual int size() const { return 3; }
+		virtual TGShape kind() const { return TG_CIRC; }
+
+		const Pt2& center() const { return _pts[0]; }
+		Vec2 axisU() const { return _pts[1] - _pts[0]; }
+		Vec2 axisV() const { return _pts[2] - _pts[0]; }
 
 		virtual void accept(Geom2Visitor* visitor, void* data) {
 			visitor->visit(this, data);
@@ -0,0 +1,75 @@
+#include "Common/WorkerPool.h"
+#include <cstdlib>
+
+using namespace std;
+
+WorkerPool::WorkerPool(int nthreads) {
+	_task = NULL;
+	_ntasks = 0;
+	_next = 0;
+	_done = 0;
+	_quit = false;
+	for (int j = 1; j < nthreads; j++)
+		_threads.push_back(thread(&WorkerPool::workerLoop, this));
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		lock_guard<mutex> lk(_lock);
+		_quit = true;
+	}
+	_wake.notify_all();
+	for (unsigned int j = 0; j < _threads.size(); j++)
+		_threads[j].join();
+}
+
+void WorkerPool::drain(unique_lock<mutex>& lk) {
+	while (_task && _next < _ntasks) {
+		int j = _next++;
+		const function<void(int)>* task = _task;
+		lk.unlock();
+		(*task)(j);
+		lk.lock();
+		if (++_done == _ntasks)
+			_finished.notify_all();
+	}
+}
+
+void WorkerPool::workerLoop() {
+	unique_lock<mutex> lk(_lock);
+	while (true) {
+		_wake.wait(lk, [this] { return _quit || (_task && _next < _ntasks); });
+		if (_quit) return;
+		drain(lk);
+	}
+}
+
+void WorkerPool::run(int ntasks, const function<void(int)>& task) {
+	if (ntasks <= 0) return;
+	if (_threads.empty() || ntasks == 1) {
+		for (int j = 0; j < ntasks; j++)
+			task(j);
+		return;
+	}
+
+	unique_lock<mutex> lk(_lock);
+	_task = &task;
+	_ntasks = ntasks;
+	_next = 0;
+	_done = 0;
+	_wake.notify_all();
+
+	drain(lk);
+	_finished.wait(lk, [this] { return _done == _ntasks; });
+	_task = NULL;
+}
+
+int WorkerPool::defaultThreads() {
+	const char* env = getenv("IFS_THREADS");
+	if (env) {
+		int n = atoi(env);
+		if (n > 0) return n;
+	}
+	int n = (int) thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
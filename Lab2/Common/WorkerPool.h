@@ -0,0 +1,45 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// A fixed set of worker threads that run batches of independent tasks.
+// run() hands out task indices to the workers and to the calling thread
+// and returns once every task has finished, so callers that write each
+// task's result into its own pre-sized slot get deterministic output
+// without any further locking.
+class WorkerPool {
+protected:
+	std::vector<std::thread> _threads;
+	std::mutex _lock;
+	std::condition_variable _wake;
+	std::condition_variable _finished;
+
+	const std::function<void(int)>* _task;
+	int _ntasks;
+	int _next;
+	int _done;
+	bool _quit;
+
+	void workerLoop();
+	// runs tasks of the current batch until none are left unclaimed
+	void drain(std::unique_lock<std::mutex>& lk);
+
+public:
+	// nthreads counts the calling thread, so 1 means no extra threads
+	explicit WorkerPool(int nthreads);
+	~WorkerPool();
+
+	int size() const { return (int) _threads.size() + 1; }
+
+	void run(int ntasks, const std::function<void(int)>& task);
+
+	// IFS_THREADS from the environment if set, else the hardware thread count
+	static int defaultThreads();
+};
+
+#endif
@@ -48,10 +48,14 @@ struct _bmpfile {
   bmp_header_t header;
   bmp_dib_v3_header_t dib;
 
-  rgb_pixel_t **pixels;
+  rgb_pixel_t *pixels;  /* row-major and bottom up, like the file */
   rgb_pixel_t *colors;
 };
 
+/* pixel (x,y) of bmp, y counted from the top */
+#define BMP_PIXEL(bmp, x, y) \
+  ((bmp)->pixels[(size_t)((bmp)->dib.height - 1 - (y)) * (bmp)->dib.width + (x)])
+
 static uint32_t
 uint32_pow(uint32_t base, uint32_t depth)
 {
@@ -249,21 +253,20 @@ bmp_free_colors(bmpfile_t *bmp)
 /**
  * Malloc the memory for pixels
  */
-static void
+static int
 bmp_malloc_pixels(bmpfile_t *bmp)
 {
-  int i, j;
+  size_t i, n = (size_t)bmp->dib.width * bmp->dib.height;
+  rgb_pixel_t white = {255, 255, 255, 0};
 
-  bmp->pixels = malloc(sizeof(rgb_pixel_t *) * bmp->dib.width);
-  for (i = 0; i < bmp->dib.width; ++i) {
-    bmp->pixels[i] = malloc(sizeof(rgb_pixel_t) * bmp->dib.height);
-    for (j = 0; j < bmp->dib.height; ++j) {
-      bmp->pixels[i][j].red = 255;
-      bmp->pixels[i][j].green = 255;
-      bmp->pixels[i][j].blue = 255;
-      bmp->pixels[i][j].alpha = 0;
-    }
-  }
+  if (bmp->dib.height != 0 && n / bmp->dib.height != bmp->dib.width)
+    return FALSE;
+  bmp->pixels = malloc(sizeof(rgb_pixel_t) * (n ? n : 1));
+  if (bmp->pixels == NULL)
+    return FALSE;
+  for (i = 0; i < n; ++i)
+    bmp->pixels[i] = white;
+  return TRUE;
 }
 
 /**
@@ -272,33 +275,19 @@ bmp_malloc_pixels(bmpfile_t *bmp)
 static void
 bmp_free_pixels(bmpfile_t *bmp)
 {
-  int i;
-
-  for (i = 0; i < bmp->dib.width; ++i)
-    free(bmp->pixels[i]);
-
   free(bmp->pixels), bmp->pixels = NULL;
 }
 
 /**
- * Create the BMP object with specified width and height and depth.
+ * Fill in the header and DIB of a width x height x depth image.
  */
-bmpfile_t *
-bmp_create(uint32_t width, uint32_t height, uint32_t depth)
+static void
+bmp_init_headers(bmpfile_t *result, uint32_t width, uint32_t height, uint32_t depth)
 {
-  bmpfile_t *result;
   double bytes_per_pixel;
   uint32_t bytes_per_line;
   uint32_t palette_size;
 
-  if (depth != 1 && depth != 4 && depth != 8 && depth != 16 && depth != 24 &&
-      depth != 32)
-    return NULL;
-
-  result = malloc(sizeof(bmpfile_t));
-
-  memset(result, 0, sizeof(bmpfile_t));
-
   result->header.magic[0] = 'B';
   result->header.magic[1] = 'M';
 
@@ -315,9 +304,6 @@ bmp_create(uint32_t width, uint32_t height, uint32_t depth)
   else
     result->dib.compress_type = BI_RGB;
 
-  bmp_malloc_pixels(result);
-  bmp_malloc_colors(result);
-
   /* Calculate the field value of header and DIB */
   bytes_per_pixel = (result->dib.depth * 1.0) / 8.0;
   bytes_per_line = (int)ceil(bytes_per_pixel * result->dib.width);
@@ -334,6 +320,30 @@ bmp_create(uint32_t width, uint32_t height, uint32_t depth)
 
   result->header.offset = 14 + result->dib.header_sz + palette_size;
   result->header.filesz = result->header.offset + result->dib.bmp_bytesz;
+}
+
+/**
+ * Create the BMP object with specified width and height and depth.
+ */
+bmpfile_t *
+bmp_create(uint32_t width, uint32_t height, uint32_t depth)
+{
+  bmpfile_t *result;
+
+  if (depth != 1 && depth != 4 && depth != 8 && depth != 16 && depth != 24 &&
+      depth != 32)
+    return NULL;
+
+  result = malloc(sizeof(bmpfile_t));
+
+  memset(result, 0, sizeof(bmpfile_t));
+
+  bmp_init_headers(result, width, height, depth);
+  if (!bmp_malloc_pixels(result)) {
+    free(result);
+    return NULL;
+  }
+  bmp_malloc_colors(result);
 
   return result;
 }
@@ -401,7 +411,7 @@ bmp_get_pixel(bmpfile_t *bmp, uint32_t x, uint32_t y)
   if ((x >= bmp->dib.width) || (y >= bmp->dib.height))
     return NULL;
 
-  return &(bmp->pixels[x][y]);
+  return &BMP_PIXEL(bmp, x, y);
 }
 
 int
@@ -410,7 +420,59 @@ bmp_set_pixel(bmpfile_t *bmp, uint32_t x, uint32_t y, rgb_pixel_t pixel)
   if ((x >= bmp->dib.width) || (y >= bmp->dib.height))
     return FALSE;
 
-  bmp->pixels[x][y] = pixel;
+  BMP_PIXEL(bmp, x, y) = pixel;
+  return TRUE;
+}
+
+/*
+ * Converts w pixels of 4 bytes in format (BMP_RGBA or BMP_BGRA) to
+ * file data of bpp bytes per pixel (3 or 4).
+ */
+static void
+bmp_convert_row(unsigned char *dst, uint32_t bpp, const uint8_t *src, uint32_t w,
+		int format)
+{
+  uint32_t i;
+
+  if (format == BMP_BGRA && bpp == 4) {
+    memcpy(dst, src, (size_t)4 * w);
+    return;
+  }
+  for (i = 0; i < w; ++i, src += 4, dst += bpp) {
+    if (format == BMP_RGBA) {
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
+    }
+    else {
+      dst[0] = src[0];
+      dst[1] = src[1];
+      dst[2] = src[2];
+    }
+    if (bpp == 4)
+      dst[3] = src[3];
+  }
+}
+
+int
+bmp_set_row(bmpfile_t *bmp, uint32_t y, const uint8_t *data, int format)
+{
+  if (y >= bmp->dib.height)
+    return FALSE;
+
+  bmp_convert_row((unsigned char *)&BMP_PIXEL(bmp, 0, y), 4, data,
+		  bmp->dib.width, format);
+  return TRUE;
+}
+
+int
+bmp_set_pixels(bmpfile_t *bmp, const uint8_t *data, int format, int flip)
+{
+  uint32_t y, h = bmp->dib.height;
+  size_t stride = (size_t)4 * bmp->dib.width;
+
+  for (y = 0; y < h; ++y)
+    bmp_set_row(bmp, flip ? h - 1 - y : y, data + y * stride, format);
   return TRUE;
 }
 
@@ -564,7 +626,7 @@ bmp_get_row_data_for_1(bmpfile_t *bmp, unsigned char *buf, size_t buf_len,
 
   while (i < bmp->dib.width) {
     for (j = 0, index = 0; j < 8 && i < bmp->dib.width; ++i, ++j)
-      index += pos_weights[j] * find_closest_color(bmp, bmp->pixels[i][row]);
+      index += pos_weights[j] * find_closest_color(bmp, BMP_PIXEL(bmp, i, row));
 
     buf[k++] = index & 0xff;
   }
@@ -582,7 +644,7 @@ bmp_get_row_data_for_4(bmpfile_t *bmp, unsigned char *buf, size_t buf_len,
 
   while (i < bmp->dib.width) {
     for (j = 0, index = 0; j < 2 && i < bmp->dib.width; ++i, ++j)
-      index += pos_weights[j] * find_closest_color(bmp, bmp->pixels[i][row]);
+      index += pos_weights[j] * find_closest_color(bmp, BMP_PIXEL(bmp, i, row));
 
     buf[k++] = index & 0xff;
   }
@@ -597,31 +659,17 @@ bmp_get_row_data_for_8(bmpfile_t *bmp, unsigned char *buf, size_t buf_len,
   if (bmp->dib.width > buf_len) return;
 
   for (i = 0; i < bmp->dib.width; ++i)
-    buf[i] = find_closest_color(bmp, bmp->pixels[i][row]);
+    buf[i] = find_closest_color(bmp, BMP_PIXEL(bmp, i, row));
 }
 
 static void
 bmp_get_row_data_for_24(bmpfile_t *bmp, unsigned char *buf, size_t buf_len,
 			uint32_t row)
 {
-  int i;
-
   if (bmp->dib.width * 3 > buf_len) return;
 
-  for (i = 0; i < bmp->dib.width; ++i)
-    memcpy(buf + 3 * i, (uint8_t *)&(bmp->pixels[i][row]), 3);
-}
-
-static void
-bmp_get_row_data_for_32(bmpfile_t *bmp, unsigned char *buf, size_t buf_len,
-			uint32_t row)
-{
-  int i;
-
-  if (bmp->dib.width * 4 > buf_len) return;
-
-  for (i = 0; i < bmp->dib.width; ++i)
-    memcpy(buf + 4 * i, (uint8_t *)&(bmp->pixels[i][row]), 4);
+  bmp_convert_row(buf, 3, (const uint8_t *)&BMP_PIXEL(bmp, 0, row),
+		  bmp->dib.width, BMP_BGRA);
 }
 
 int
@@ -650,9 +698,9 @@ bmp_save(bmpfile_t *bmp, const char *filename)
       uint32_t write_number = 0;
 
       for (i = 0; write_number < data_bytes; ++i, write_number += 2) {
-	uint16_t red = (uint16_t)(bmp->pixels[i][row].red / 8);
-	uint16_t green = (uint16_t)(bmp->pixels[i][row].green / 4);
-	uint16_t blue = (uint16_t)(bmp->pixels[i][row].blue / 8);
+	uint16_t red = (uint16_t)(BMP_PIXEL(bmp, i, row).red / 8);
+	uint16_t green = (uint16_t)(BMP_PIXEL(bmp, i, row).green / 4);
+	uint16_t blue = (uint16_t)(BMP_PIXEL(bmp, i, row).blue / 8);
 	uint16_t value = (red << 11) + (green << 5) + blue;
 
 	if (_is_big_endian()) value = UINT16_SWAP_LE_BE_CONSTANT(value);
@@ -663,6 +711,10 @@ bmp_save(bmpfile_t *bmp, const char *filename)
 	fwrite(&zero_byte, 1, 1, fp);
     }
   }
+  else if (bmp->dib.depth == 32) {
+    /* rows of 4 byte pixels need no padding, the buffer is the file data */
+    fwrite(bmp->pixels, (size_t)4 * bmp->dib.width, bmp->dib.height, fp);
+  }
   else {
     double bytes_per_pixel;
     int bytes_per_line;
@@ -693,10 +745,6 @@ bmp_save(bmpfile_t *bmp, const char *filename)
       case 24:
 	bmp_get_row_data_for_24(bmp, buf, bytes_per_line, row);
 	break;
-
-      case 32:
-	bmp_get_row_data_for_32(bmp, buf, bytes_per_line, row);
-	break;
       }
 
       fwrite(buf, bytes_per_line, 1, fp);
@@ -708,3 +756,157 @@ bmp_save(bmpfile_t *bmp, const char *filename)
 
   return TRUE;
 }
+
+int
+bmp_save_buffer(const char *filename, uint32_t width, uint32_t height,
+		uint32_t depth, const uint8_t *data, int format, int flip)
+{
+  bmpfile_t hdr;
+  FILE *fp;
+  uint32_t bpp = depth / 8, y;
+  size_t stride = (size_t)4 * width;
+  unsigned long long bytes_per_line;
+  unsigned char *buf;
+  int ok;
+
+  if ((depth != 24 && depth != 32) || width == 0 || height == 0)
+    return FALSE;
+  bytes_per_line = ((unsigned long long)width * bpp + 3) / 4 * 4;
+  if (bytes_per_line * height + 14 + 40 > 0xffffffffULL)
+    return FALSE;
+
+  memset(&hdr, 0, sizeof(hdr));
+  bmp_init_headers(&hdr, width, height, depth);
+  if ((fp = fopen(filename, "wb")) == NULL)
+    return FALSE;
+  bmp_write_header(&hdr, fp);
+  bmp_write_dib(&hdr, fp);
+
+  if (bpp == 4 && format == BMP_BGRA && flip) {
+    /* already the file data */
+    fwrite(data, stride, height, fp);
+  }
+  else {
+    if ((buf = malloc((size_t)bytes_per_line)) == NULL) {
+      fclose(fp);
+      return FALSE;
+    }
+    memset(buf, 0, (size_t)bytes_per_line);
+    /* the file starts with the bottom row */
+    for (y = 0; y < height; ++y) {
+      const uint8_t *src = data + (size_t)(flip ? y : height - 1 - y) * stride;
+      bmp_convert_row(buf, bpp, src, width, format);
+      fwrite(buf, (size_t)bytes_per_line, 1, fp);
+    }
+    free(buf);
+  }
+
+  ok = !ferror(fp);
+  ok = (fclose(fp) == 0) && ok;
+  return ok ? TRUE : FALSE;
+}
+
+/*
+ * Streaming writer: only the headers are kept, pixels go to the file as
+ * they are handed in, so memory does not grow with the image.
+ */
+struct _bmpstream {
+  FILE *fp;
+  bmpfile_t hdr;       /* headers only, no pixels */
+  uint32_t bytes_per_line;
+  unsigned char *buf;  /* one row of file data */
+};
+
+static int
+bmp_stream_seek(FILE *fp, unsigned long long pos)
+{
+#ifdef _WIN32
+  return _fseeki64(fp, (__int64)pos, SEEK_SET);
+#else
+  return fseeko(fp, (off_t)pos, SEEK_SET);
+#endif
+}
+
+bmpstream_t *
+bmp_stream_open(const char *filename, uint32_t width, uint32_t height, uint32_t depth)
+{
+  bmpstream_t *bs;
+  unsigned long long bytes_per_line, data_bytes;
+  unsigned char zero_byte = 0;
+
+  if ((depth != 24 && depth != 32) || width == 0 || height == 0)
+    return NULL;
+
+  /* the sizes in the headers are 32 bit */
+  bytes_per_line = ((unsigned long long)width * (depth / 8) + 3) / 4 * 4;
+  data_bytes = bytes_per_line * height;
+  if (data_bytes + 14 + 40 > 0xffffffffULL)
+    return NULL;
+
+  bs = malloc(sizeof(bmpstream_t));
+  memset(bs, 0, sizeof(bmpstream_t));
+  bmp_init_headers(&bs->hdr, width, height, depth);
+  bs->bytes_per_line = (uint32_t)bytes_per_line;
+
+  if ((bs->fp = fopen(filename, "wb")) == NULL) {
+    free(bs);
+    return NULL;
+  }
+  bs->buf = malloc(bs->bytes_per_line);
+  memset(bs->buf, 0, bs->bytes_per_line);
+
+  bmp_write_header(&bs->hdr, bs->fp);
+  bmp_write_dib(&bs->hdr, bs->fp);
+
+  /* size the file up front, parts never written stay zero */
+  bmp_stream_seek(bs->fp, (unsigned long long)bs->hdr.header.filesz - 1);
+  fwrite(&zero_byte, 1, 1, bs->fp);
+
+  return bs;
+}
+
+int
+bmp_stream_write_tile(bmpstream_t *bs, uint32_t x, uint32_t y, uint32_t w,
+		      uint32_t h, const rgb_pixel_t *pixels)
+{
+  uint32_t width = bs->hdr.dib.width;
+  uint32_t height = bs->hdr.dib.height;
+  uint32_t bpp = bs->hdr.dib.depth / 8;
+  uint32_t r;
+
+  if (x >= width || y >= height || w > width - x || h > height - y)
+    return FALSE;
+
+  for (r = 0; r < h; ++r) {
+    const rgb_pixel_t *src = pixels + (size_t)r * w;
+    /* rows are stored bottom up */
+    unsigned long long pos = bs->hdr.header.offset +
+      (unsigned long long)(height - 1 - (y + r)) * bs->bytes_per_line +
+      (unsigned long long)x * bpp;
+
+    bmp_convert_row(bs->buf, bpp, (const uint8_t *)src, w, BMP_BGRA);
+
+    if (bmp_stream_seek(bs->fp, pos) != 0 ||
+	fwrite(bs->buf, (size_t)bpp * w, 1, bs->fp) != 1)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+int
+bmp_stream_write_rows(bmpstream_t *bs, uint32_t y, uint32_t nrows,
+		      const rgb_pixel_t *pixels)
+{
+  return bmp_stream_write_tile(bs, 0, y, bs->hdr.dib.width, nrows, pixels);
+}
+
+int
+bmp_stream_close(bmpstream_t *bs)
+{
+  int ok = !ferror(bs->fp);
+
+  ok = (fclose(bs->fp) == 0) && ok;
+  free(bs->buf);
+  free(bs);
+  return ok ? TRUE : FALSE;
+}
@@ -151,5 +151,40 @@ rgb_pixel_t *bmp_get_pixel(bmpfile_t *bmp, uint32_t x, uint32_t y);
 int bmp_set_pixel(bmpfile_t *bmp, uint32_t x, uint32_t y, rgb_pixel_t pixel);
 int bmp_save(bmpfile_t *bmp, const char *filename);
 
+/*
+ * Bulk access from 4 byte per pixel memory, in either byte order; BMP_BGRA
+ * is the layout of rgb_pixel_t.  Rows of data go from the top unless flip
+ * is set, in which case they go bottom up as glReadPixels returns them.
+ */
+#define BMP_RGBA 0
+#define BMP_BGRA 1
+
+/* row y (from the top) from width pixels of data */
+int bmp_set_row(bmpfile_t *bmp, uint32_t y, const uint8_t *data, int format);
+/* the whole image from width x height pixels of data */
+int bmp_set_pixels(bmpfile_t *bmp, const uint8_t *data, int format, int flip);
+/*
+ * Writes width x height pixels of data as a 24 or 32 bit file without
+ * copying them into a bmpfile_t; flipped BGRA at 32 bit goes out in one write.
+ */
+int bmp_save_buffer(const char *filename, uint32_t width, uint32_t height,
+		    uint32_t depth, const uint8_t *data, int format, int flip);
+
+/*
+ * Streaming writer for images too big to hold: the file is laid out when
+ * it is opened and rows or tiles are written straight to their place, in
+ * any order.  y counts from the top like bmp_set_pixel; pixels are w x h,
+ * row after row.  Only 24 and 32 bit, and the file has to stay under 4GB.
+ */
+typedef struct _bmpstream bmpstream_t;
+
+bmpstream_t *bmp_stream_open(const char *filename, uint32_t width, uint32_t height,
+			     uint32_t depth);
+int bmp_stream_write_tile(bmpstream_t *bs, uint32_t x, uint32_t y, uint32_t w,
+			  uint32_t h, const rgb_pixel_t *pixels);
+int bmp_stream_write_rows(bmpstream_t *bs, uint32_t y, uint32_t nrows,
+			  const rgb_pixel_t *pixels);
+int bmp_stream_close(bmpstream_t *bs);
+
 
 #endif /* __bmpfile_h__ */
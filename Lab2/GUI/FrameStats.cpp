@@ -0,0 +1,203 @@
+#include "GUI/FrameStats.h"
+#include "Common/AllocStats.h"
+#include <FL/gl.h>
+#include <FL/glut.H>
+#include <FL/Fl_File_Chooser.H>
+#include <GL/glu.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+static const char* TIMER_NAMES[ST_COUNT] = {"frame","draw","pick","apply","prepare"};
+static const char* COUNTER_NAMES[SC_COUNT] = {"verts","hit tests","allocs","collapsed"};
+
+// trace timestamps count from here
+static const chrono::steady_clock::time_point STATS_EPOCH = chrono::steady_clock::now();
+
+FrameStats::FrameStats(const char* name){
+	static int viewers = 0;
+	_name = name;
+	_tid = ++viewers;
+	_enabled = false;
+	_history.resize(STATS_HISTORY);
+	_next = 0;
+	_frames = 0;
+	_trace = false;
+	_dumped = 0;
+	resetFrame();
+}
+
+FrameStats::~FrameStats(){
+	stopDump();
+}
+
+double FrameStats::micros(Clock::time_point t){
+	return chrono::duration<double,micro>(t-STATS_EPOCH).count();
+}
+
+void FrameStats::resetFrame(){
+	memset(&_cur,0,sizeof(_cur));
+	_frameStart = Clock::now();
+	_allocStart = AllocStats::count();
+}
+
+void FrameStats::setEnabled(bool on){
+	if(on==_enabled) return;
+	_enabled = on;
+	_next = 0;
+	_frames = 0;
+	resetFrame();
+	if(!on) stopDump();
+}
+
+void FrameStats::addTime(StatTimer t, Clock::time_point start, Clock::time_point end){
+	if(!_enabled) return;
+	_cur.time[t] += chrono::duration<double>(end-start).count();
+
+	if(dumping() && _trace){
+		char buf[256];
+		sprintf(buf,",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+			TIMER_NAMES[t],_tid,micros(start),micros(end)-micros(start));
+		_dump<<buf;
+	}
+}
+
+void FrameStats::endFrame(){
+	if(!_enabled) return;
+	Clock::time_point now = Clock::now();
+	_cur.time[ST_FRAME] = chrono::duration<double>(now-_frameStart).count();
+	_cur.count[SC_ALLOCS] = AllocStats::count()-_allocStart;
+
+	_history[_next] = _cur;
+	_next = (_next+1)%STATS_HISTORY;
+	if(_frames<STATS_HISTORY) _frames++;
+
+	if(dumping()){
+		char buf[256];
+		if(_trace){
+			sprintf(buf,",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+				"\"args\":{\"verts\":%lld,\"hit_tests\":%lld,\"allocs\":%lld,\"collapsed\":%lld}}",
+				_name.c_str(),_tid,micros(now),_cur.count[SC_VERTS],_cur.count[SC_HITTESTS],_cur.count[SC_ALLOCS],
+				_cur.count[SC_COLLAPSED]);
+		}
+		else{
+			sprintf(buf,"%lld,%.3f,%.4f,%.4f,%.4f,%.4f,%.4f,%lld,%lld,%lld,%lld\n",
+				_dumped,micros(now)/1000,_cur.time[ST_FRAME]*1e3,_cur.time[ST_DRAW]*1e3,
+				_cur.time[ST_PICK]*1e3,_cur.time[ST_APPLY]*1e3,_cur.time[ST_PREPARE]*1e3,
+				_cur.count[SC_VERTS],_cur.count[SC_HITTESTS],_cur.count[SC_ALLOCS],_cur.count[SC_COLLAPSED]);
+		}
+		_dump<<buf;
+		_dumped++;
+	}
+
+	memset(&_cur,0,sizeof(_cur));
+	_frameStart = now;
+	_allocStart = AllocStats::count();
+}
+
+void FrameStats::drawOverlay(int w, int h){
+	if(!_enabled) return;
+
+	Frame avg, mx;
+	memset(&avg,0,sizeof(avg));
+	memset(&mx,0,sizeof(mx));
+	for(int f=0;f<_frames;f++){
+		const Frame& fr = _history[f];
+		for(int t=0;t<ST_COUNT;t++){
+			avg.time[t] += fr.time[t]/_frames;
+			mx.time[t] = max(mx.time[t],fr.time[t]);
+		}
+		for(int c=0;c<SC_COUNT;c++){
+			avg.count[c] += fr.count[c];
+			mx.count[c] = max(mx.count[c],fr.count[c]);
+		}
+	}
+
+	vector<string> lines;
+	char buf[128];
+	sprintf(buf,"%s, last %d frames",_name.c_str(),_frames);
+	lines.push_back(buf);
+	sprintf(buf,"%-9s %8.1f fps",TIMER_NAMES[ST_FRAME],avg.time[ST_FRAME]>0 ? 1/avg.time[ST_FRAME] : 0.);
+	lines.push_back(buf);
+	for(int t=0;t<ST_COUNT;t++){
+		sprintf(buf,"%-9s %8.2f ms %8.2f max",TIMER_NAMES[t],avg.time[t]*1e3,mx.time[t]*1e3);
+		lines.push_back(buf);
+	}
+	for(int c=0;c<SC_COUNT;c++){
+		sprintf(buf,"%-9s %8.0f    %8lld max",COUNTER_NAMES[c],_frames ? avg.count[c]/(double)_frames : 0.,mx.count[c]);
+		lines.push_back(buf);
+	}
+	if(dumping()){
+		sprintf(buf,"dumping, %lld frames",_dumped);
+		lines.push_back(buf);
+	}
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	gluOrtho2D(0,w,0,h);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	const int lh = 15;
+	glColor4d(0,0,0,.75);
+	glRecti(4,h-8-lh*(int)lines.size(),8+8*36,h-4);
+	glColor3d(1,1,0);
+	for(int j=0;j<(int)lines.size();j++){
+		glRasterPos2i(8,h-4-lh*(j+1));
+		glutBitmapString(GLUT_BITMAP_8_BY_13,(const unsigned char*)lines[j].c_str());
+	}
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+
+	// the overlay's own allocations are not the next frame's
+	_allocStart = AllocStats::count();
+}
+
+bool FrameStats::startDump(const char* filename){
+	stopDump();
+	_dump.open(filename,ios::out);
+	if(!_dump) return false;
+
+	size_t len = strlen(filename);
+	_trace = len>=5 && strcmp(filename+len-5,".json")==0;
+	_dumped = 0;
+	if(_trace){
+		_dump<<"[{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"<<_tid
+			<<",\"args\":{\"name\":\""<<_name<<"\"}}";
+	}
+	else
+		_dump<<"frame,t_ms,frame_ms,draw_ms,pick_ms,apply_ms,prepare_ms,verts,hit_tests,allocs,collapsed"<<endl;
+	setEnabled(true);
+	return true;
+}
+
+void FrameStats::stopDump(){
+	if(!dumping()) return;
+	if(_trace) _dump<<"\n]"<<endl;
+	_dump.close();
+}
+
+bool FrameStats::handleKey(int key, bool shift){
+	if(key!='p') return false;
+
+	if(!shift)
+		setEnabled(!_enabled);
+	else if(dumping()){
+		cout<<_name<<": "<<_dumped<<" frames dumped"<<endl;
+		stopDump();
+	}
+	else{
+		char* newfile = fl_file_chooser("Dump frame stats", "Stats (*.{csv,json})", "./stats.csv", 0);
+		if(newfile && !startDump(newfile))
+			cout<<"cannot write "<<newfile<<endl;
+	}
+	return true;
+}
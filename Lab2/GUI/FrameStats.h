@@ -0,0 +1,101 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Timings and counters of a viewer's hot paths, gathered per frame.  Every
+// draw() closes a frame, and whatever ran since the one before (picking,
+// Apply, prepareGeom) is charged to it.  The last STATS_HISTORY frames are
+// averaged for the overlay; while dumping, every frame is also written to
+// a CSV file, or every timed scope to a trace-event JSON file that
+// chrome://tracing and Perfetto open.
+//
+// Allocations are counted for the whole process (Common/AllocStats.h), so
+// they include other threads such as the chaos preview.  Nothing is
+// measured while the stats are off, so the timers can stay in the hot paths.
+
+enum StatTimer { ST_FRAME, ST_DRAW, ST_PICK, ST_APPLY, ST_PREPARE, ST_COUNT };
+enum StatCounter { SC_VERTS, SC_HITTESTS, SC_ALLOCS, SC_COLLAPSED, SC_COUNT };
+
+#define STATS_HISTORY 120 // frames averaged in the overlay
+
+class FrameStats{
+protected:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Frame{
+		double time[ST_COUNT]; // seconds
+		long long count[SC_COUNT];
+	};
+
+	std::string _name;
+	int _tid; // thread id of this viewer in trace dumps
+	bool _enabled;
+
+	Frame _cur;
+	Clock::time_point _frameStart;
+	long long _allocStart;
+
+	std::vector<Frame> _history; // ring, _frames of them valid
+	int _next;
+	int _frames;
+
+	std::ofstream _dump;
+	bool _trace; // trace events instead of CSV
+	long long _dumped;
+
+	void resetFrame();
+	static double micros(Clock::time_point t);
+
+public:
+	FrameStats(const char* name);
+	~FrameStats();
+
+	bool enabled() const { return _enabled; }
+	void setEnabled(bool on);
+
+	void addTime(StatTimer t, Clock::time_point start, Clock::time_point end);
+	void count(StatCounter c, long long n=1) { if(_enabled) _cur.count[c] += n; }
+
+	// called by draw() once the frame is done
+	void endFrame();
+
+	// the overlay in the top left corner of a w x h viewer, right after
+	// endFrame(); leaves the projection and modelview matrices as it found them
+	void drawOverlay(int w, int h);
+
+	// .json writes trace events, anything else CSV
+	bool startDump(const char* filename);
+	void stopDump();
+	bool dumping() const { return _dump.is_open(); }
+
+	// p toggles the overlay, shift-p dumping to a file; true if key was one
+	// of them
+	bool handleKey(int key, bool shift);
+};
+
+// charges the time until stop() or the end of the scope to a timer
+class ScopedTimer{
+protected:
+	FrameStats* _stats;
+	StatTimer _timer;
+	std::chrono::steady_clock::time_point _start;
+public:
+	ScopedTimer(FrameStats* stats, StatTimer t){
+		_stats = stats->enabled() ? stats : NULL;
+		_timer = t;
+		if(_stats) _start = std::chrono::steady_clock::now();
+	}
+	~ScopedTimer() { stop(); }
+
+	void stop(){
+		if(!_stats) return;
+		_stats->addTime(_timer,_start,std::chrono::steady_clock::now());
+		_stats = NULL;
+	}
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "GUI/RedrawScheduler.h" 
+
+using namespace std; 
+
+RedrawScheduler::RedrawScheduler(Fl_Widget* w, double maxFps){
+	_widget = w; 
+	_pending = false; 
+	_last = chrono::steady_clock::now()-chrono::hours(1); 
+	setMaxFps(maxFps); 
+}
+
+RedrawScheduler::~RedrawScheduler(){
+	Fl::remove_timeout(RedrawScheduler::fireCb,this); 
+}
+
+void RedrawScheduler::setMaxFps(double fps){
+	_interval = 1/(fps>1 ? fps : 1.); 
+}
+
+void RedrawScheduler::request(){
+	if(_pending) return; 
+
+	double since = chrono::duration<double>(chrono::steady_clock::now()-_last).count(); 
+	if(since>=_interval){
+		fire(); 
+		return; 
+	}
+
+	_pending = true; 
+	Fl::add_timeout(_interval-since,RedrawScheduler::fireCb,this); 
+}
+
+void RedrawScheduler::fire(){
+	_pending = false; 
+	_last = chrono::steady_clock::now(); 
+	_widget->redraw(); 
+}
+
+void RedrawScheduler::fireCb(void* userdata){
+	((RedrawScheduler*) userdata)->fire(); 
+}
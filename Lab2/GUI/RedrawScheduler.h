@@ -0,0 +1,33 @@
+#ifndef REDRAW_SCHEDULER_H
+#define REDRAW_SCHEDULER_H
+
+#include <FL/Fl.H>
+#include <FL/Fl_Widget.H>
+#include <chrono>
+
+#define REDRAW_MAX_FPS 60.
+
+// Redraws a widget only when something asked for it.  Requests made
+// before the next frame is due are merged into one redraw, so the widget
+// is drawn at most maxFps times a second and not at all while idle.
+class RedrawScheduler{
+protected: 
+	Fl_Widget* _widget; 
+	double _interval; 
+	bool _pending; 
+	std::chrono::steady_clock::time_point _last; 
+
+	void fire(); 
+	static void fireCb(void* userdata); 
+
+public: 
+	RedrawScheduler(Fl_Widget* w, double maxFps=REDRAW_MAX_FPS); 
+	~RedrawScheduler(); 
+
+	void setMaxFps(double fps); 
+	double getMaxFps() const { return 1/_interval; }
+
+	void request(); 
+}; 
+
+#endif
@@ -1,13 +1,13 @@
 #include "Rendering/BaseGrid.h" 
 #include <cmath>
-#include <map>
+#include <algorithm>
 #include <list> 
-#include <set> 
 
 using namespace std; 
 
 BaseGrid::BaseGrid(){
 	_level = 1; 
+	_n = 2; 
 	_base = NULL; 
 }
 
@@ -21,79 +21,105 @@ void BaseGrid::subdivide(int times){
 	if(!_base) return; 
 
 	_level = times; 
+	_n = 1<<times; 
 	_pts.clear(); 
-	_tris.clear(); 
 	_edges.clear(); 
+	_lines.clear(); 
 
-	_pts.push_back(*_base->get(0)); 
-	_pts.push_back(*_base->get(1)); 
-	_pts.push_back(*_base->get(2)); 
+	_origin = *_base->get(0); 
+	_e1 = *_base->get(1)-_origin; 
+	_e2 = *_base->get(2)-_origin; 
 
-	_tris.push_back(make_triple(0,1,2)); 
-	_edges.push_back(make_pair(0,1)); 
-	_edges.push_back(make_pair(1,2)); 
-	_edges.push_back(make_pair(2,0)); 
+	_pts.reserve((_n+1)*(_n+2)/2); 
+	for(int j=0;j<=_n;j++){
+		for(int i=0;i<=_n-j;i++)
+			_pts.push_back(_origin+(i/(double)_n)*_e1+(j/(double)_n)*_e2); 
+	}
 
-	for(int tt=0;tt<times;tt++){
-		map<pair<int,int>,int> e2p; 
-		list<triple<int> > ntris; 
-		for(list<triple<int> >::iterator i=_tris.begin();i!=_tris.end();i++){
-			pair<int,int> es[3]={make_pair(i->a,i->b),make_pair(i->b,i->c),make_pair(i->c,i->a)}; 
-			int ntri[3]; 
-			for(int j=0;j<3;j++){
-				if(e2p.find(es[j])==e2p.end()){
-					Pt2 np = .5*(_pts[es[j].first]+_pts[es[j].second]); 
-					e2p[es[j]] = _pts.size(); 
-					ntri[j] = _pts.size(); 
-					_pts.push_back(np); 
-				}
-				else
-					ntri[j] = e2p[es[j]]; 
-			}
-			triple<int> ntrip; 
-			// middle triangle
-			ntrip.a = ntri[0]; 
-			ntrip.b = ntri[1]; 
-			ntrip.c = ntri[2]; 
-			ntris.push_back(ntrip); 
+	// the edges of the subdivided triangles line up into straight lines 
+	// parallel to the three sides, one segment per line is enough to draw them
+	for(int k=0;k<_n;k++){
+		_edges.push_back(make_pair(latticeIndex(0,k),latticeIndex(_n-k,k))); 
+		_edges.push_back(make_pair(latticeIndex(k,0),latticeIndex(k,_n-k))); 
+		_edges.push_back(make_pair(latticeIndex(k+1,0),latticeIndex(0,k+1))); 
+	}
+	for(list<pair<int,int> >::iterator i=_edges.begin();i!=_edges.end();i++){
+		_lines.push_back((float)_pts[i->first][0]); 
+		_lines.push_back((float)_pts[i->first][1]); 
+		_lines.push_back((float)_pts[i->second][0]); 
+		_lines.push_back((float)_pts[i->second][1]); 
+	}
 
-			// top triangle
-			ntrip.a = i->a; 
-			ntrip.b = ntri[0]; 
-			ntrip.c = ntri[2]; 
-			ntris.push_back(ntrip);
+	for(list<pair<ChangedCb,void*> >::iterator i=_listeners.begin();i!=_listeners.end();i++)
+		i->first(i->second); 
+}
 
-			// left triangle
-			ntrip.a = ntri[0]; 
-			ntrip.b = i->b; 
-			ntrip.c = ntri[1]; 
-			ntris.push_back(ntrip); 
+pair<double,int> BaseGrid::findClosest(const Pt2& p) const{
+	double det = _e1[0]*_e2[1]-_e1[1]*_e2[0]; 
+	if(fabs(det)<1e-12){
+		// degenerate base, no lattice to round on
+		double bestd = Utils::dist2d(_pts[0],p); 
+		int best = 0; 
+		for(unsigned int j=1;j<_pts.size();j++){
+			double nd = Utils::dist2d(_pts[j],p); 
+			if(nd<bestd){
+				bestd = nd; 
+				best = j; 
+			}
+		}
+		return make_pair(bestd,best); 
+	}
 
-			// left triangle
-			ntrip.a = ntri[2]; 
-			ntrip.b = ntri[1]; 
-			ntrip.c = i->c; 
-			ntris.push_back(ntrip); 
+	// lattice coordinates of p 
+	Vec2 pd = p-_origin; 
+	double pu = (pd[0]*_e2[1]-pd[1]*_e2[0])/det*_n; 
+	double pv = (_e1[0]*pd[1]-_e1[1]*pd[0])/det*_n; 
 
-			_edges.push_back(make_pair(ntri[0],ntri[1])); 
-			_edges.push_back(make_pair(ntri[1],ntri[2])); 
-			_edges.push_back(make_pair(ntri[2],ntri[0])); 
+	// a first guess: round the coordinates of p, or for points outside the 
+	// triangle, of the closest point on its boundary
+	double u = pu, v = pv; 
+	if(pu<0 || pv<0 || pu+pv>_n){
+		Pt2 corners[3] = {_origin,_origin+_e1,_origin+_e2}; 
+		Pt2 q = p; 
+		double bestd = 1e300; 
+		for(int j=0;j<3;j++){
+			Pt2 a = corners[j]; 
+			Vec2 ab = corners[(j+1)%3]-a; 
+			double t = ((p-a)*ab)/(ab*ab); 
+			Pt2 c = a+min(1.,max(0.,t))*ab; 
+			double nd = Utils::dist2d(c,p); 
+			if(nd<bestd){
+				bestd = nd; 
+				q = c; 
+			}
 		}
-		_tris = ntris; 
+		Vec2 d = q-_origin; 
+		u = (d[0]*_e2[1]-d[1]*_e2[0])/det*_n; 
+		v = (_e1[0]*d[1]-_e1[1]*d[0])/det*_n; 
 	}
-}
+	int cj = min(_n,max(0,(int)floor(v+.5))); 
+	int ci = min(_n-cj,max(0,(int)floor(u+.5))); 
+	int best = latticeIndex(ci,cj); 
+	double bestd = Utils::dist2d(_pts[best],p); 
 
-pair<double,int> BaseGrid::findClosest(const Pt2& p) const{
-	double bestd = Utils::dist2d(_pts[0],p); 
-	int best = 0; 
-	for(unsigned int j=1;j<_pts.size();j++){
-		double nd = Utils::dist2d(_pts[j],p); 
-		if(nd<bestd){
-			bestd = nd; 
-			best = j; 
+	// any closer point is within bestd of p, which bounds how far its 
+	// lattice coordinates can be from (pu,pv); for a well shaped base 
+	// that is only the few points around the guess
+	double du = bestd*mag(_e2)*_n/fabs(det); 
+	double dv = bestd*mag(_e1)*_n/fabs(det); 
+
+	int j0 = (int)max(0.,ceil(pv-dv)), j1 = (int)min((double)_n,floor(pv+dv)); 
+	for(int j=j0;j<=j1;j++){
+		int i0 = (int)max(0.,ceil(pu-du)), i1 = (int)min((double)(_n-j),floor(pu+du)); 
+		for(int i=i0;i<=i1;i++){
+			int ind = latticeIndex(i,j); 
+			double nd = Utils::dist2d(_pts[ind],p); 
+			if(nd<bestd){
+				bestd = nd; 
+				best = ind; 
+			}
 		}
 	}
-
 	return make_pair(bestd,best); 
 }
 
@@ -1,43 +1,41 @@
 #ifndef BASE_GRID_H
 #define BASE_GRID_H
 
-#include <Fl/Fl_Hor_Value_Slider.H> 
+#include <FL/Fl_Hor_Value_Slider.H> 
 #include "Common/TinyGeom.h" 
 #include <list> 
 #include <vector> 
 
 using namespace TinyGeom; 
 
-template<typename T>
-class triple{
-public:
-	T a,b,c; 
-}; 
-
-template<typename T> 
-triple<T> make_triple(const T& a, const T& b, const T& c){
-	triple<T> ret; 
-	ret.a = a; 
-	ret.b = b; 
-	ret.c = c; 
-	return ret; 
-}
-
 class BaseGrid{
 protected: 
 	Tri2* _base; 
-	std::list<triple<int> > _tris; 
 	std::list<pair<int,int> > _edges; 
 	std::vector<Pt2> _pts; 
+	std::vector<float> _lines; // the edges again as x,y pairs, for glDrawArrays
 	int _level ; 
 
+	// the subdivision is the lattice origin + i/n e1 + j/n e2, i+j<=n, 
+	// n = 2^level, stored row (j) by row
+	int _n; 
+	Pt2 _origin; 
+	Vec2 _e1, _e2; 
+	int latticeIndex(int i, int j) const { return j*(_n+1)-j*(j-1)/2+i; }
+
+	// called after every change, so viewers can schedule a redraw
+	typedef void (*ChangedCb)(void* userdata); 
+	std::list<pair<ChangedCb,void*> > _listeners; 
+
 public: 
 	BaseGrid(); 
 	void setBase(Tri2* tri); 
+	void addListener(ChangedCb cb, void* userdata) { _listeners.push_back(make_pair(cb,userdata)); }
 	void subdivide(int times); 
 	int level() { return _level; }
 	const std::vector<Pt2>& getPts() { return _pts;}
 	const std::list<pair<int,int> >& getEdges() { return _edges; }
+	const std::vector<float>& getLines() { return _lines; }
 	pair<double,int> findClosest(const Pt2& p) const; 
 	static void subdivValueCb(Fl_Widget* widget, void* userdata); 
 }; 
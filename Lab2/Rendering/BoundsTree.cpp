@@ -0,0 +1,116 @@
+#include "Rendering/BoundsTree.h"
+#include <algorithm>
+
+using namespace std;
+
+BoundsTree::BoundsTree(){
+	_gb = NULL;
+	_first = 1;
+}
+
+void BoundsTree::range(int n, int& first, int& last) const{
+	int lo = n, hi = n;
+	while(lo<_first){
+		lo = 2*lo;
+		hi = 2*hi+1;
+	}
+	first = (lo-_first)*BOUNDS_LEAF_SIZE;
+	last = min((hi-_first+1)*BOUNDS_LEAF_SIZE,_gb->size())-1;
+}
+
+void BoundsTree::unite(int n){
+	double* b = &_boxes[4*n];
+	if(n>=_first){
+		int first, last;
+		range(n,first,last);
+		b[0] = b[1] = 1e300;
+		b[2] = b[3] = -1e300;
+		for(int i=first;i<=last;i++){
+			const double* s = &_shapeBoxes[4*i];
+			b[0] = min(b[0],s[0]);
+			b[1] = min(b[1],s[1]);
+			b[2] = max(b[2],s[2]);
+			b[3] = max(b[3],s[3]);
+		}
+		return;
+	}
+	const double* l = &_boxes[8*n];
+	const double* r = &_boxes[8*n+4];
+	b[0] = min(l[0],r[0]);
+	b[1] = min(l[1],r[1]);
+	b[2] = max(l[2],r[2]);
+	b[3] = max(l[3],r[3]);
+}
+
+void BoundsTree::build(const GeometryBatch* gb){
+	_gb = gb;
+	_first = 1;
+	_boxes.clear();
+	_shapeBoxes.clear();
+	if(!gb || gb->size()==0) return;
+
+	int ns = gb->size();
+	_shapeBoxes.resize(4*ns);
+	for(int i=0;i<ns;i++)
+		gb->bounds(i,&_shapeBoxes[4*i]);
+
+	int nleaves = (ns+BOUNDS_LEAF_SIZE-1)/BOUNDS_LEAF_SIZE;
+	while(_first<nleaves) _first *= 2;
+	_boxes.resize(8*_first);
+	for(int n=2*_first-1;n>=1;n--)
+		unite(n);
+}
+
+void BoundsTree::moved(int i){
+	if(!_gb || i<0 || i>=_gb->size() || 4*i>=(int)_shapeBoxes.size()) return;
+	_gb->bounds(i,&_shapeBoxes[4*i]);
+	for(int n=_first+i/BOUNDS_LEAF_SIZE;n>=1;n/=2)
+		unite(n);
+}
+
+void BoundsTree::query(const Pt2& ll, const Pt2& ur, double pixel, vector<int>& shapes,
+	vector<ImplicitIFS::Dot>& dots) const{
+	if(_boxes.empty()) return;
+
+	// depth first, left child on top of the stack so indices come out in order
+	int stack[64];
+	int top = 0;
+	stack[top++] = 1;
+	while(top>0){
+		int n = stack[--top];
+		const double* b = &_boxes[4*n];
+		if(b[2]<ll[0] || b[0]>ur[0] || b[3]<ll[1] || b[1]>ur[1])
+			continue;
+
+		int first, last;
+		if(max(b[2]-b[0],b[3]-b[1])<pixel){
+			range(n,first,last);
+			ImplicitIFS::Dot d;
+			d.p = Pt2((b[0]+b[2])*.5,(b[1]+b[3])*.5);
+			d.color = _gb->packedColor(last);
+			dots.push_back(d);
+			continue;
+		}
+
+		if(n<_first){
+			stack[top++] = 2*n+1;
+			stack[top++] = 2*n;
+			continue;
+		}
+
+		range(n,first,last);
+		for(int i=first;i<=last;i++){
+			const double* s = &_shapeBoxes[4*i];
+			if(s[2]<ll[0] || s[0]>ur[0] || s[3]<ll[1] || s[1]>ur[1])
+				continue;
+			if(max(s[2]-s[0],s[3]-s[1])<pixel){
+				ImplicitIFS::Dot d;
+				d.p = Pt2((s[0]+s[2])*.5,(s[1]+s[3])*.5);
+				d.color = _gb->packedColor(i);
+				dots.push_back(d);
+			}
+			else
+				shapes.push_back(i);
+		}
+	}
+}
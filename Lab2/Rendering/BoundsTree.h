@@ -0,0 +1,47 @@
+#ifndef BOUNDS_TREE_H
+#define BOUNDS_TREE_H
+
+// bounding box hierarchy over the shapes of a GeometryBatch for drawing
+// only what is on screen.  Leaves hold BOUNDS_LEAF_SIZE consecutive shapes
+// and every node the boxes of its two children, so the tree follows index
+// order: shapes from one map of an Apply sit next to each other, and a
+// query walks the tree left to right and gets them back in drawing order
+// without sorting.  Shapes edited after build() are refitted with moved().
+
+#include "Rendering/GeometryBatch.h"
+#include "Rendering/ImplicitIFS.h"
+#include <vector>
+
+using namespace std;
+
+#define BOUNDS_LEAF_SIZE 8 // consecutive shapes per leaf
+
+class BoundsTree{
+protected:
+	const GeometryBatch* _gb;
+	int _first; // node index of the first leaf, a power of two
+
+	// 4 per node (minx,miny,maxx,maxy), node n has children 2n and 2n+1;
+	// node 0 is unused
+	vector<double> _boxes;
+	vector<double> _shapeBoxes; // 4 per shape
+
+	// the shapes under node n are [first,last]
+	void range(int n, int& first, int& last) const;
+	void unite(int n);
+
+public:
+	BoundsTree();
+
+	void build(const GeometryBatch* gb);
+
+	// shape i changed, refits its leaf and the nodes above it
+	void moved(int i);
+
+	// shapes touching [ll,ur], in index order.  A shape or a whole node
+	// narrower than pixel becomes a dot in the colour of its topmost shape.
+	void query(const Pt2& ll, const Pt2& ur, double pixel, vector<int>& shapes,
+		vector<ImplicitIFS::Dot>& dots) const;
+};
+
+#endif
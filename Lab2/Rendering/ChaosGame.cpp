@@ -0,0 +1,168 @@
+#include "Rendering/ChaosGame.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+// the orbit forgets its start point well within this many steps for any
+// reasonably contractive IFS
+#define CHAOS_SETTLE_STEPS 64
+
+ChaosGame::ChaosGame(const Affine::Map* maps, int k, unsigned long long seed){
+	_maps.assign(maps,maps+k);
+	_seed = seed;
+
+	vector<double> w = determinantWeights(maps,k);
+	setWeights(w.empty() ? NULL : &w[0]);
+}
+
+bool ChaosGame::sameMaps(const Affine::Map* maps, int k) const{
+	return k==size() && (k==0 || memcmp(maps,&_maps[0],k*sizeof(Affine::Map))==0);
+}
+
+void ChaosGame::setWeights(const double* w){
+	int k = size();
+	_cdf.resize(k);
+	double sum = 0;
+	for(int m=0;m<k;m++)
+		sum += max(0.,w[m]);
+	double acc = 0;
+	for(int m=0;m<k;m++){
+		acc += sum>0 ? max(0.,w[m])/sum : 1./k;
+		_cdf[m] = acc;
+	}
+	if(k>0) _cdf[k-1] = 1;
+}
+
+void ChaosGame::setColors(const Color* colors){
+	_rgb.clear();
+	if(!colors) return;
+	for(int m=0;m<size();m++)
+		for(int j=0;j<3;j++)
+			_rgb.push_back((float)colors[m][j]);
+}
+
+vector<double> ChaosGame::determinantWeights(const Affine::Map* maps, int k){
+	vector<double> ret(k);
+	double maxd = 0;
+	for(int m=0;m<k;m++){
+		ret[m] = fabs(maps[m].a*maps[m].d-maps[m].b*maps[m].c);
+		maxd = max(maxd,ret[m]);
+	}
+	for(int m=0;m<k;m++)
+		ret[m] = max(ret[m],maxd>0 ? .01*maxd : 1.);
+	return ret;
+}
+
+ChaosGame::Walker ChaosGame::newWalker(int j) const{
+	// splitmix64 of the seed spreads the walkers' streams apart
+	unsigned long long z = _seed+(j+1)*0x9E3779B97F4A7C15ULL;
+	z = (z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+	z = (z^(z>>27))*0x94D049BB133111EBULL;
+	z ^= z>>31;
+
+	Walker wk;
+	wk.state = z ? z : 1;
+	wk.p = Pt2(0,0);
+	wk.rgb[0] = wk.rgb[1] = wk.rgb[2] = 1;
+	wk.settled = false;
+	return wk;
+}
+
+void ChaosGame::settle(Walker& wk) const{
+	wk.p = Pt2(0,0);
+	for(int j=0;j<CHAOS_SETTLE_STEPS;j++){
+		int m = step(wk);
+		if(!_rgb.empty()){
+			for(int c=0;c<3;c++)
+				wk.rgb[c] = (wk.rgb[c]+_rgb[3*m+c])*.5f;
+		}
+	}
+	wk.settled = true;
+}
+
+void ChaosGame::runWalker(Walker& wk, DensityHistogram& hist, long long n) const{
+	if(!wk.settled) settle(wk);
+
+	if(_rgb.empty() || !hist.colored()){
+		for(long long j=0;j<n;j++){
+			step(wk);
+			hist.add(wk.p[0],wk.p[1]);
+		}
+	}
+	else{
+		const float* rgb = &_rgb[0];
+		for(long long j=0;j<n;j++){
+			int m = step(wk);
+			wk.rgb[0] = (wk.rgb[0]+rgb[3*m])*.5f;
+			wk.rgb[1] = (wk.rgb[1]+rgb[3*m+1])*.5f;
+			wk.rgb[2] = (wk.rgb[2]+rgb[3*m+2])*.5f;
+			hist.add(wk.p[0],wk.p[1],wk.rgb);
+		}
+	}
+	// an expanding map sends the point off to infinity, start over
+	if(!(fabs(wk.p[0])<1e300 && fabs(wk.p[1])<1e300))
+		wk.settled = false;
+}
+
+void ChaosGame::run(DensityHistogram& hist, long long n, WorkerPool* pool){
+	if(_maps.empty() || n<=0) return;
+
+	int ntasks = pool ? pool->size() : 1;
+	size_t copies = CHAOS_LOCAL_BYTES/max(hist.bytes(),(size_t)1);
+	if((size_t)ntasks>1+copies)
+		ntasks = (int)(1+copies);
+	while((int)_walkers.size()<ntasks)
+		_walkers.push_back(newWalker((int)_walkers.size()));
+
+	if(ntasks==1){
+		runWalker(_walkers[0],hist,n);
+		return;
+	}
+
+	// task 0 writes straight into hist, the others into histograms of
+	// their own that are summed into hist afterwards
+	vector<DensityHistogram*> local(ntasks,(DensityHistogram*)NULL);
+	for(int t=1;t<ntasks;t++)
+		local[t] = new DensityHistogram(hist.width(),hist.height(),hist.ll(),hist.ur(),hist.colored());
+	local[0] = &hist;
+
+	pool->run(ntasks,[&](int t){
+		long long n0 = n*t/ntasks;
+		long long n1 = n*(t+1)/ntasks;
+		Walker wk = _walkers[t]; // a local copy keeps the walkers off each other's cache lines
+		runWalker(wk,*local[t],n1-n0);
+		_walkers[t] = wk;
+	});
+
+	// reduce in bands of rows so every thread helps with the sum
+	int h = hist.height();
+	int nbands = min(h,ntasks*4);
+	pool->run(nbands,[&](int b){
+		int r0 = (int)((long long)h*b/nbands);
+		int r1 = (int)((long long)h*(b+1)/nbands);
+		for(int t=1;t<ntasks;t++)
+			hist.merge(*local[t],r0,r1);
+	});
+
+	for(int t=1;t<ntasks;t++)
+		delete local[t];
+}
+
+bool ChaosGame::bounds(long long n, Pt2& ll, Pt2& ur){
+	if(_maps.empty()) return false;
+
+	Walker wk = newWalker(-1);
+	settle(wk);
+	ll = Pt2(1e300,1e300);
+	ur = Pt2(-1e300,-1e300);
+	for(long long j=0;j<n;j++){
+		step(wk);
+		ll = Pt2(min(ll[0],wk.p[0]),min(ll[1],wk.p[1]));
+		ur = Pt2(max(ur[0],wk.p[0]),max(ur[1],wk.p[1]));
+	}
+	if(!(fabs(wk.p[0])<1e300 && fabs(wk.p[1])<1e300))
+		return false;
+	return ll[0]<=ur[0] && ll[1]<=ur[1];
+}
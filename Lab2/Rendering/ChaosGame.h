@@ -0,0 +1,90 @@
+#ifndef CHAOS_GAME_H
+#define CHAOS_GAME_H
+
+// random-iteration evaluation of an IFS: one point is moved through maps
+// picked at random and every position after the first few is a sample of
+// the attractor.  Unlike applying every map to every shape, the cost is
+// linear in the number of points and the memory is just the histogram.
+//
+// With a WorkerPool every task runs its own orbit into its own histogram,
+// and the histograms are summed at the end, so the threads share nothing
+// while the points are generated.  Large histograms get fewer tasks, so
+// those copies stay within CHAOS_LOCAL_BYTES whatever the thread count.
+
+#include "Common/AffineKernel.h"
+#include "Common/WorkerPool.h"
+#include "Rendering/DensityHistogram.h"
+#include <vector>
+
+using namespace std;
+
+#define CHAOS_LOCAL_BYTES ((size_t)256<<20) // most the per-task histograms of a run take
+
+class ChaosGame{
+protected:
+	// one orbit; the colour drifts halfway towards the colour of each map
+	// it goes through, so a point remembers its recent maps
+	struct Walker{
+		unsigned long long state;
+		Pt2 p;
+		float rgb[3];
+		bool settled;
+	};
+
+	vector<Affine::Map> _maps;
+	vector<double> _cdf; // cumulative probabilities, last one is 1
+	vector<float> _rgb; // 3 per map, empty without colours
+	unsigned long long _seed;
+	vector<Walker> _walkers; // one per task of the last run
+
+	// xorshift64*, rand() is both slow and shared
+	static unsigned long long next(Walker& wk){
+		wk.state ^= wk.state>>12;
+		wk.state ^= wk.state<<25;
+		wk.state ^= wk.state>>27;
+		return wk.state*2685821657736338717ULL;
+	}
+	int pick(Walker& wk) const {
+		double u = (next(wk)>>11)*(1./9007199254740992.);
+		int m = 0;
+		while(m+1<(int)_cdf.size() && u>=_cdf[m]) m++;
+		return m;
+	}
+	int step(Walker& wk) const {
+		int m = pick(wk);
+		const Affine::Map& M = _maps[m];
+		wk.p = Pt2(M.a*wk.p[0]+M.c*wk.p[1]+M.e, M.b*wk.p[0]+M.d*wk.p[1]+M.f);
+		return m;
+	}
+	void settle(Walker& wk) const;
+	Walker newWalker(int j) const;
+	void runWalker(Walker& wk, DensityHistogram& hist, long long n) const;
+
+public:
+	// probabilities default to determinantWeights(maps,k)
+	ChaosGame(const Affine::Map* maps, int k, unsigned long long seed=1);
+
+	int size() const { return (int) _maps.size(); }
+	bool sameMaps(const Affine::Map* maps, int k) const;
+
+	// w need not be normalized
+	void setWeights(const double* w);
+	double probability(int m) const { return _cdf[m]-(m>0 ? _cdf[m-1] : 0); }
+
+	// one colour per map, blended into coloured histograms; NULL for none
+	void setColors(const Color* colors);
+
+	// weight of each map is the area it keeps, |det| of its linear part;
+	// maps that collapse to a line still get a small share so their part
+	// of the attractor shows up
+	static vector<double> determinantWeights(const Affine::Map* maps, int k);
+
+	// adds n more points to hist, split over the pool's threads if given
+	// and the copies of hist they need fit CHAOS_LOCAL_BYTES
+	void run(DensityHistogram& hist, long long n, WorkerPool* pool=NULL);
+
+	// bounding box of n points, false if the orbit escapes
+	bool bounds(long long n, Pt2& ll, Pt2& ur);
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "Rendering/ChaosPreview.h"
+#include "Rendering/ChaosGame.h"
+
+ChaosPreview::ChaosPreview(Fl_Awake_Handler ready, void* readyData)
+	: _quit(false), _pending(false), _w(0), _h(0), _job(0),
+	_result(NULL), _resultJob(0), _ready(ready), _readyData(readyData){
+	_thread = thread(&ChaosPreview::workerLoop,this);
+}
+
+ChaosPreview::~ChaosPreview(){
+	{
+		lock_guard<mutex> lk(_lock);
+		_quit = true;
+		_job++;
+	}
+	_wake.notify_one();
+	_thread.join();
+	delete _result;
+}
+
+void ChaosPreview::restart(const vector<Affine::Map>& maps, const vector<Color>& colors,
+	int w, int h, const Pt2& ll, const Pt2& ur){
+	{
+		lock_guard<mutex> lk(_lock);
+		_maps = maps;
+		_colors = colors;
+		_w = w;
+		_h = h;
+		_ll = ll;
+		_ur = ur;
+		_pending = !maps.empty();
+		_job++;
+	}
+	_wake.notify_one();
+}
+
+void ChaosPreview::stop(){
+	lock_guard<mutex> lk(_lock);
+	_pending = false;
+	_job++;
+}
+
+DensityHistogram* ChaosPreview::take(){
+	lock_guard<mutex> lk(_lock);
+	DensityHistogram* ret = NULL;
+	if(_result && _resultJob==_job)
+		ret = _result;
+	else
+		delete _result;
+	_result = NULL;
+	return ret;
+}
+
+void ChaosPreview::publish(const DensityHistogram& hist, unsigned int job){
+	DensityHistogram* copy = new DensityHistogram(hist);
+	{
+		lock_guard<mutex> lk(_lock);
+		if(job!=_job){
+			delete copy;
+			return;
+		}
+		delete _result; // not picked up yet, the new one has more points
+		_result = copy;
+		_resultJob = job;
+	}
+	Fl::awake(_ready,_readyData);
+}
+
+void ChaosPreview::workerLoop(){
+	for(;;){
+		vector<Affine::Map> maps;
+		vector<Color> colors;
+		int w, h;
+		Pt2 ll, ur;
+		unsigned int job;
+		{
+			unique_lock<mutex> lk(_lock);
+			while(!_quit && !_pending)
+				_wake.wait(lk);
+			if(_quit) return;
+			maps = _maps;
+			colors = _colors;
+			w = _w;
+			h = _h;
+			ll = _ll;
+			ur = _ur;
+			job = _job;
+			_pending = false;
+		}
+
+		ChaosGame chaos(&maps[0],(int)maps.size(),job+1);
+		if(colors.size()==maps.size())
+			chaos.setColors(&colors[0]);
+		DensityHistogram hist(w,h,ll,ur,true);
+
+		long long done = 0;
+		long long next = PREVIEW_FIRST_POINTS;
+		while(done<PREVIEW_MAX_POINTS && job==_job){
+			chaos.run(hist,PREVIEW_CHUNK);
+			done += PREVIEW_CHUNK;
+			if(done>=next || done>=PREVIEW_MAX_POINTS){
+				publish(hist,job);
+				next *= 2;
+			}
+		}
+	}
+}
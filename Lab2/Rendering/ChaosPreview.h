@@ -0,0 +1,73 @@
+#ifndef CHAOS_PREVIEW_H
+#define CHAOS_PREVIEW_H
+
+// Runs the chaos game on a thread of its own so the attractor can follow
+// an IFS while it is being edited.  restart() only swaps in the new job;
+// the worker drops whatever pass it is in at its next chunk of points and
+// starts over.  Each job is published after PREVIEW_FIRST_POINTS points
+// and again every time the count doubles, up to PREVIEW_MAX_POINTS, so
+// the picture gets denser the longer the IFS is left alone.
+
+#include "Common/TinyGeom.h"
+#include "Common/AffineKernel.h"
+#include "Rendering/DensityHistogram.h"
+#include <FL/Fl.H>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+using namespace std;
+
+#define PREVIEW_CHUNK 32768 // points between two checks for a newer job
+#define PREVIEW_FIRST_POINTS 65536
+#define PREVIEW_MAX_POINTS 20000000
+
+class ChaosPreview{
+protected:
+	thread _thread;
+	mutex _lock;
+	condition_variable _wake;
+	bool _quit;
+
+	// the newest job, guarded by _lock
+	bool _pending;
+	vector<Affine::Map> _maps;
+	vector<Color> _colors;
+	int _w, _h;
+	Pt2 _ll, _ur;
+
+	// bumped by every restart(); a pass started for an older job stops
+	// as soon as it sees the change
+	atomic<unsigned int> _job;
+
+	// latest published density and the job it belongs to, guarded by _lock
+	DensityHistogram* _result;
+	unsigned int _resultJob;
+
+	Fl_Awake_Handler _ready;
+	void* _readyData;
+
+	void workerLoop();
+	void publish(const DensityHistogram& hist, unsigned int job);
+
+public:
+	// ready(readyData) runs in the FLTK thread, through Fl::awake, every
+	// time a denser result can be picked up with take()
+	ChaosPreview(Fl_Awake_Handler ready, void* readyData);
+	~ChaosPreview();
+
+	// starts over for these maps, one colour each, on a w x h grid
+	// over [ll,ur]; returns at once
+	void restart(const vector<Affine::Map>& maps, const vector<Color>& colors,
+		int w, int h, const Pt2& ll, const Pt2& ur);
+	// drops the current job, the worker goes idle
+	void stop();
+
+	// the newest result of the current job, NULL if there is none; the
+	// caller owns it
+	DensityHistogram* take();
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "Rendering/DensityHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+extern "C" {
+#include "Common/bmpfile.h"
+}
+
+using namespace std;
+
+DensityHistogram::DensityHistogram(int w, int h, const Pt2& ll, const Pt2& ur, bool colored){
+	if(!fits(w,h,colored))
+		w = h = 0;
+	_w = w;
+	_h = h;
+	_ll = ll;
+	_ur = ur;
+	_sx = w/(ur[0]-ll[0]);
+	_sy = h/(ur[1]-ll[1]);
+	_counts.resize((size_t)w*h);
+	if(colored)
+		_rgb.resize(3*(size_t)w*h);
+	_total = 0;
+}
+
+void DensityHistogram::clear(){
+	fill(_counts.begin(),_counts.end(),0u);
+	fill(_rgb.begin(),_rgb.end(),0.f);
+	_total = 0;
+}
+
+void DensityHistogram::merge(const DensityHistogram& o, int r0, int r1){
+	size_t i0 = (size_t)r0*_w, i1 = (size_t)r1*_w;
+	for(size_t i=i0;i<i1;i++){
+		unsigned int c = _counts[i]+o._counts[i];
+		_counts[i] = c<_counts[i] ? UINT_MAX : c;
+	}
+	if(colored() && o.colored()){
+		for(size_t i=3*i0;i<3*i1;i++)
+			_rgb[i] += o._rgb[i];
+	}
+	if(r0==0)
+		_total += o._total;
+}
+
+unsigned int DensityHistogram::maxCount() const{
+	unsigned int ret = 0;
+	for(size_t j=0;j<_counts.size();j++)
+		ret = max(ret,_counts[j]);
+	return ret;
+}
+
+void DensityHistogram::toRGBA(unsigned char* rgba, const Color& color, double gamma) const{
+	unsigned int maxc = maxCount();
+	double norm = maxc>0 ? 1./log(1.+maxc) : 0;
+	double invg = 1./max(gamma,1e-3);
+
+	float rgb[3];
+	for(int j=0;j<3;j++)
+		rgb[j] = (float)min(1.,max(0.,color[j]));
+
+	size_t n = (size_t)_w*_h;
+	for(size_t i=0;i<n;i++){
+		unsigned char* px = rgba+4*i;
+		unsigned int c = _counts[i];
+		if(c==0){
+			px[0] = px[1] = px[2] = px[3] = 0;
+			continue;
+		}
+		double v = pow(log(1.+c)*norm,invg)*255;
+		const float* hue = rgb;
+		float avg[3];
+		if(colored()){
+			for(int j=0;j<3;j++)
+				avg[j] = min(1.f,_rgb[3*i+j]/c);
+			hue = avg;
+		}
+		for(int j=0;j<3;j++)
+			px[j] = (unsigned char)(hue[j]*v+.5);
+		px[3] = 255;
+	}
+}
+
+bool DensityHistogram::save(const char* filename, const Color& color, double gamma) const{
+	if(_w==0 || _h==0) return false;
+	size_t n = (size_t)_w*_h;
+	vector<unsigned char> rgba(4*n);
+	toRGBA(&rgba[0],color,gamma);
+
+	// the file is opaque, empty pixels included
+	for(size_t i=0;i<n;i++)
+		rgba[4*i+3] = 255;
+	return bmp_save_buffer(filename,_w,_h,32,&rgba[0],BMP_RGBA,FALSE)!=0;
+}
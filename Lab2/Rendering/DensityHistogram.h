@@ -0,0 +1,98 @@
+#ifndef DENSITY_HISTOGRAM_H
+#define DENSITY_HISTOGRAM_H
+
+// hit counts of a point cloud over a w x h pixel grid covering the
+// drawing-space window [ll,ur]; row 0 is the top of the image.  Memory is
+// fixed by the grid size, however many points are added.  A coloured
+// histogram also sums the colour each point carries, so pixels can show
+// the average colour of what landed in them.
+
+#include "Common/TinyGeom.h"
+#include <vector>
+#include <climits>
+
+using namespace std;
+using namespace TinyGeom;
+
+#define DENSITY_GAMMA 2.2
+#define DENSITY_MAX_BYTES ((size_t)1<<30) // largest histogram made
+
+class DensityHistogram{
+protected:
+	int _w,_h;
+	Pt2 _ll,_ur;
+	double _sx,_sy; // pixels per drawing-space unit
+	vector<unsigned int> _counts;
+	vector<float> _rgb; // colour sums, 3 per pixel, empty if not coloured
+	long long _total;
+
+	static const size_t NO_PIXEL = (size_t)-1;
+	size_t pixel(double x, double y) const {
+		double fx = (x-_ll[0])*_sx;
+		double fy = (_ur[1]-y)*_sy;
+		if(fx>=0 && fx<_w && fy>=0 && fy<_h)
+			return (size_t)fy*_w+(size_t)fx;
+		return NO_PIXEL;
+	}
+
+public:
+	// a grid fits() turns down is left 0 x 0
+	DensityHistogram(int w, int h, const Pt2& ll, const Pt2& ur, bool colored=false);
+
+	// memory a w x h grid takes, and whether it is within DENSITY_MAX_BYTES
+	static double bytes(int w, int h, bool colored) {
+		return (double)w*h*(sizeof(unsigned int)+(colored ? 3*sizeof(float) : 0));
+	}
+	static bool fits(int w, int h, bool colored) {
+		return w>0 && h>0 && bytes(w,h,colored)<=DENSITY_MAX_BYTES;
+	}
+	size_t bytes() const { return (size_t)bytes(_w,_h,colored()); }
+
+	int width() const { return _w; }
+	int height() const { return _h; }
+	const Pt2& ll() const { return _ll; }
+	const Pt2& ur() const { return _ur; }
+	bool colored() const { return !_rgb.empty(); }
+
+	// true if o covers the same pixels of the same window
+	bool sameGrid(const DensityHistogram& o) const {
+		return _w==o._w && _h==o._h && _ll[0]==o._ll[0] && _ll[1]==o._ll[1] &&
+			_ur[0]==o._ur[0] && _ur[1]==o._ur[1];
+	}
+
+	void clear();
+
+	// points outside the window are counted in total() only
+	void add(double x, double y){
+		_total++;
+		size_t i = pixel(x,y);
+		if(i!=NO_PIXEL && _counts[i]!=UINT_MAX) _counts[i]++;
+	}
+	void add(double x, double y, const float* rgb){
+		_total++;
+		size_t i = pixel(x,y);
+		if(i!=NO_PIXEL && _counts[i]!=UINT_MAX){
+			_counts[i]++;
+			_rgb[3*i] += rgb[0];
+			_rgb[3*i+1] += rgb[1];
+			_rgb[3*i+2] += rgb[2];
+		}
+	}
+
+	// adds rows [r0,r1) of o, which must have the same grid; totals are
+	// only added along with row 0 so merging in bands counts them once
+	void merge(const DensityHistogram& o, int r0, int r1);
+	void merge(const DensityHistogram& o) { merge(o,0,_h); }
+
+	unsigned int count(int c, int r) const { return _counts[(size_t)r*_w+c]; }
+	unsigned int maxCount() const;
+	long long total() const { return _total; }
+
+	// RGBA pixels, row 0 at the top.  Brightness is log(1+hits)/log(1+max)
+	// raised to 1/gamma; the hue is the pixel's average colour, or color
+	// for a histogram without colours.  Alpha is 0 where nothing landed.
+	void toRGBA(unsigned char* rgba, const Color& color, double gamma=DENSITY_GAMMA) const;
+	bool save(const char* filename, const Color& color, double gamma=DENSITY_GAMMA) const;
+};
+
+#endif
@@ -0,0 +1,308 @@
+#include "Rendering/GeometryBatch.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+using namespace std;
+
+void GeometryBatch::clear(){
+	_xs.clear();
+	_ys.clear();
+	_offsets.clear();
+	_counts.clear();
+	_kinds.clear();
+	_colors.clear();
+}
+
+size_t GeometryBatch::bytes() const{
+	return sizeof(*this)
+		+(_xs.capacity()+_ys.capacity())*sizeof(double)
+		+(_offsets.capacity()+_counts.capacity())*sizeof(int)
+		+_kinds.capacity()*sizeof(unsigned char)
+		+_colors.capacity()*sizeof(unsigned int);
+}
+
+size_t GeometryBatch::bytes(double nshapes, double nverts){
+	double ret = sizeof(GeometryBatch)
+		+nverts*2*sizeof(double)
+		+nshapes*(2*sizeof(int)+sizeof(unsigned char)+sizeof(unsigned int));
+	return ret<(double)(size_t)-1 ? (size_t)ret : (size_t)-1;
+}
+
+void GeometryBatch::reserve(int nshapes, int nverts){
+	_xs.reserve(nverts);
+	_ys.reserve(nverts);
+	_offsets.reserve(nshapes);
+	_counts.reserve(nshapes);
+	_kinds.reserve(nshapes);
+	_colors.reserve(nshapes);
+}
+
+int GeometryBatch::add(TGShape kind, int n, unsigned int color){
+	int ind = size();
+	_offsets.push_back(numVerts());
+	_counts.push_back(n);
+	_kinds.push_back((unsigned char) kind);
+	_colors.push_back(color);
+	_xs.resize(_xs.size()+n);
+	_ys.resize(_ys.size()+n);
+	return ind;
+}
+
+void GeometryBatch::assign(int nshapes, int nverts, const double* xs, const double* ys, const int* offsets,
+	const int* counts, const unsigned char* kinds, const unsigned int* colors){
+	_xs.assign(xs,xs+nverts);
+	_ys.assign(ys,ys+nverts);
+	_offsets.assign(offsets,offsets+nshapes);
+	_counts.assign(counts,counts+nshapes);
+	_kinds.assign(kinds,kinds+nshapes);
+	_colors.assign(colors,colors+nshapes);
+}
+
+int GeometryBatch::add(TGShape kind, const double* xs, const double* ys, int n, unsigned int color){
+	int ind = add(kind,n,color);
+	int off = _offsets[ind];
+	for(int j=0;j<n;j++){
+		_xs[off+j] = xs[j];
+		_ys[off+j] = ys[j];
+	}
+	return ind;
+}
+
+int GeometryBatch::add(const Geom2* g, const Color& c){
+	int ind = add(g->kind(),g->size(),packColor(c));
+	int off = _offsets[ind];
+	for(int j=0;j<g->size();j++){
+		_xs[off+j] = (*g->get(j))[0];
+		_ys[off+j] = (*g->get(j))[1];
+	}
+	return ind;
+}
+
+void GeometryBatch::addImages(const GeometryBatch& src, const Affine::Map* maps, int k, WorkerPool* pool){
+	int nsrc = src.size();
+	int nv = src.numVerts();
+	int nshape = size();
+	int base = numVerts();
+	if(k<=0 || nsrc==0) return;
+
+	// size everything up front so each task only writes its own slots
+	_offsets.resize(nshape+nsrc*k);
+	_counts.resize(nshape+nsrc*k);
+	_kinds.resize(nshape+nsrc*k);
+	_colors.resize(nshape+nsrc*k);
+	_xs.resize(base+nv*k);
+	_ys.resize(base+nv*k);
+
+	int ntasks = pool ? min(nsrc,pool->size()*4) : 1;
+
+	function<void(int)> task = [&](int t){
+		int s0 = (int)((long long)nsrc*t/ntasks);
+		int s1 = (int)((long long)nsrc*(t+1)/ntasks);
+		if(s0==s1) return;
+
+		int v0 = src._offsets[s0];
+		int v1 = s1<nsrc ? src._offsets[s1] : nv;
+
+		vector<double*> oxs(k), oys(k);
+		for(int m=0;m<k;m++){
+			int sh = nshape+m*nsrc;
+			for(int i=s0;i<s1;i++){
+				_offsets[sh+i] = base+m*nv+src._offsets[i];
+				_counts[sh+i] = src._counts[i];
+				_kinds[sh+i] = src._kinds[i];
+				_colors[sh+i] = src._colors[i];
+			}
+			oxs[m] = &_xs[base+m*nv+v0];
+			oys[m] = &_ys[base+m*nv+v0];
+		}
+		Affine::applyMaps(maps,k,src.xs()+v0,src.ys()+v0,v1-v0,&oxs[0],&oys[0]);
+	};
+
+	if(pool)
+		pool->run(ntasks,task);
+	else
+		task(0);
+}
+
+void GeometryBatch::remove(const set<int>& shapes){
+	if(shapes.empty()) return;
+
+	vector<char> keep(size(),1);
+	for(set<int>::const_iterator i=shapes.begin();i!=shapes.end();i++)
+		keep[*i] = 0;
+	compact(keep);
+}
+
+void GeometryBatch::compact(const vector<char>& keep){
+	int nshape = 0;
+	int nvert = 0;
+	for(int i=0;i<size();i++){
+		if(!keep[i]) continue;
+
+		int off = _offsets[i];
+		int n = _counts[i];
+		for(int j=0;j<n;j++){
+			_xs[nvert+j] = _xs[off+j];
+			_ys[nvert+j] = _ys[off+j];
+		}
+		_offsets[nshape] = nvert;
+		_counts[nshape] = n;
+		_kinds[nshape] = _kinds[i];
+		_colors[nshape] = _colors[i];
+		nvert += n;
+		nshape++;
+	}
+
+	_xs.resize(nvert);
+	_ys.resize(nvert);
+	_offsets.resize(nshape);
+	_counts.resize(nshape);
+	_kinds.resize(nshape);
+	_colors.resize(nshape);
+}
+
+void GeometryBatch::bounds(int i, double* b) const{
+	int off = _offsets[i];
+	if(isEllipse(i)){
+		Utils::ellipseBounds(pt(off),pt(off+1)-pt(off),pt(off+2)-pt(off),b);
+		return;
+	}
+	b[0] = b[1] = 1e300;
+	b[2] = b[3] = -1e300;
+	for(int v=off;v<off+_counts[i];v++){
+		b[0] = min(b[0],_xs[v]);
+		b[1] = min(b[1],_ys[v]);
+		b[2] = max(b[2],_xs[v]);
+		b[3] = max(b[3],_ys[v]);
+	}
+}
+
+int GeometryBatch::outlineSize(int i, double pixel, const Affine::Map* m) const{
+	if(!isEllipse(i)) return _counts[i];
+
+	int off = _offsets[i];
+	Vec2 u = pt(off+1)-pt(off);
+	Vec2 v = pt(off+2)-pt(off);
+	if(m){
+		u = Vec2(m->a*u[0]+m->c*u[1],m->b*u[0]+m->d*u[1]);
+		v = Vec2(m->a*v[0]+m->c*v[1],m->b*v[0]+m->d*v[1]);
+	}
+	return Utils::ellipseSegments(u,v,pixel);
+}
+
+void GeometryBatch::outline(int i, int n, double* xs, double* ys) const{
+	int off = _offsets[i];
+	if(isEllipse(i)){
+		Utils::tessellateEllipse(pt(off),pt(off+1)-pt(off),pt(off+2)-pt(off),n,xs,ys);
+		return;
+	}
+	copy(&_xs[off],&_xs[off]+n,xs);
+	copy(&_ys[off],&_ys[off]+n,ys);
+}
+
+double GeometryBatch::area(int i) const{
+	if(isEllipse(i)){
+		int off = _offsets[i];
+		return M_PI*Utils::cross2d(pt(off+1)-pt(off),pt(off+2)-pt(off));
+	}
+	const double* xs = &_xs[_offsets[i]];
+	const double* ys = &_ys[_offsets[i]];
+	int n = _counts[i];
+	double ret = 0;
+	for(int j=0,k=n-1;j<n;k=j++)
+		ret += xs[k]*ys[j]-xs[j]*ys[k];
+	return ret*.5;
+}
+
+int GeometryBatch::dedup(double quantum, double minArea){
+	vector<char> keep(size(),1);
+	int removed = 0;
+
+	// canonical vertex tuple of every shape: kind, colour, count, then
+	// the rounded vertices of a polygon from the smallest one on, towards
+	// its smaller neighbour.  Shapes with equal hashes are compared tuple by tuple.
+	vector<long long> keys;
+	vector<size_t> keyStart(size()+1,0);
+	unordered_multimap<size_t,int> seen;
+	vector<long long> q;
+	for(int i=0;i<size();i++){
+		keyStart[i+1] = keys.size();
+		if(fabs(area(i))<minArea){
+			keep[i] = 0;
+			removed++;
+			continue;
+		}
+		if(quantum<=0) continue;
+
+		int n = _counts[i];
+		int off = _offsets[i];
+		q.resize(2*n);
+		for(int j=0;j<n;j++){
+			q[2*j] = llround(_xs[off+j]/quantum);
+			q[2*j+1] = llround(_ys[off+j]/quantum);
+		}
+		// an ellipse's points are not a cycle, they are compared as they are
+		int s = 0, dir = 1;
+		if(!isEllipse(i)){
+			for(int j=1;j<n;j++)
+				if(q[2*j]<q[2*s] || (q[2*j]==q[2*s] && q[2*j+1]<q[2*s+1])) s = j;
+			int nx = (s+1)%n, pv = (s+n-1)%n;
+			if(q[2*pv]<q[2*nx] || (q[2*pv]==q[2*nx] && q[2*pv+1]<q[2*nx+1])) dir = n-1;
+		}
+
+		keys.push_back(_kinds[i]);
+		keys.push_back(_colors[i]);
+		keys.push_back(n);
+		for(int j=0,v=s;j<n;j++,v=(v+dir)%n){
+			keys.push_back(q[2*v]);
+			keys.push_back(q[2*v+1]);
+		}
+		keyStart[i+1] = keys.size();
+
+		size_t h = 0;
+		for(size_t j=keyStart[i];j<keys.size();j++)
+			h = h*1000003u^hash<long long>()(keys[j]);
+
+		bool dup = false;
+		pair<unordered_multimap<size_t,int>::iterator,unordered_multimap<size_t,int>::iterator> r = seen.equal_range(h);
+		for(unordered_multimap<size_t,int>::iterator j=r.first;j!=r.second && !dup;j++){
+			int o = j->second;
+			dup = keyStart[o+1]-keyStart[o]==keys.size()-keyStart[i] &&
+				equal(keys.begin()+keyStart[i],keys.end(),keys.begin()+keyStart[o]);
+		}
+		if(dup){
+			keep[i] = 0;
+			removed++;
+			keys.resize(keyStart[i]);
+			keyStart[i+1] = keyStart[i];
+		}
+		else
+			seen.insert(make_pair(h,i));
+	}
+
+	if(removed>0) compact(keep);
+	return removed;
+}
+
+int GeometryBatch::shapeOf(int v) const{
+	// offsets are increasing, the owner is the last shape starting at or before v
+	vector<int>::const_iterator it = upper_bound(_offsets.begin(),_offsets.end(),v);
+	return (int)(it-_offsets.begin())-1;
+}
+
+unsigned int GeometryBatch::packColor(const Color& c){
+	unsigned int ret = 0;
+	for(int j=0;j<4;j++){
+		double v = min(1.,max(0.,c[j]));
+		ret |= ((unsigned int)(v*255+.5))<<(8*j);
+	}
+	return ret;
+}
+
+Color GeometryBatch::unpackColor(unsigned int c){
+	Color ret;
+	for(int j=0;j<4;j++)
+		ret[j] = ((c>>(8*j))&0xff)/255.;
+	return ret;
+}
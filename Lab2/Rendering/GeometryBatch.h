@@ -0,0 +1,116 @@
+#ifndef GEOMETRY_BATCH_H
+#define GEOMETRY_BATCH_H
+
+// one generation of shapes for the GeometryViewer, stored as flat arrays:
+// every vertex x, every vertex y, and per shape its first vertex, vertex
+// count, kind and packed colour.  Shapes are addressed by index, vertices
+// by their index into the x/y arrays.
+//
+// Circles are stored as the three points of a Circ2 (centre and the ends
+// of two conjugate radii), so maps move them exactly and they cost three
+// vertices instead of an outline; anything drawing or filling a shape goes
+// through outline(), which tessellates them for the pixel size at hand.
+
+#include "Common/TinyGeom.h"
+#include "Common/AffineKernel.h"
+#include "Common/WorkerPool.h"
+#include <vector>
+#include <set>
+
+using namespace std;
+using namespace TinyGeom;
+
+class GeometryBatch{
+protected:
+	vector<double> _xs;
+	vector<double> _ys;
+	vector<int> _offsets;
+	vector<int> _counts;
+	vector<unsigned char> _kinds;
+	vector<unsigned int> _colors; // 0xAABBGGRR
+
+	// keeps the shapes i with keep[i], in order
+	void compact(const vector<char>& keep);
+
+public:
+	int size() const { return (int) _offsets.size(); }
+	int numVerts() const { return (int) _xs.size(); }
+
+	void clear();
+	void reserve(int nshapes, int nverts);
+	// memory held, reserved capacity included
+	size_t bytes() const;
+	// roughly what a batch of nshapes shapes and nverts vertices holds
+	static size_t bytes(double nshapes, double nverts);
+
+	// appends a shape and returns its index
+	int add(const Geom2* g, const Color& c);
+	int add(TGShape kind, const double* xs, const double* ys, int n, unsigned int color);
+	// appends a shape whose n vertices are left for the caller to fill
+	int add(TGShape kind, int n, unsigned int color);
+	// replaces everything by copies of the given arrays
+	void assign(int nshapes, int nverts, const double* xs, const double* ys, const int* offsets,
+		const int* counts, const unsigned char* kinds, const unsigned int* colors);
+
+	// appends, for every map in turn, the image of every shape in src.  The
+	// images under maps[m] form one contiguous block of src.numVerts()
+	// vertices, so the whole step is a single pass of Affine::applyMaps.
+	// With a pool the source shapes are split into ranges, and each task
+	// fills the slots of its range in all k blocks; the result is the
+	// same whatever the thread count.
+	void addImages(const GeometryBatch& src, const Affine::Map* maps, int k, WorkerPool* pool=NULL);
+
+	// removes the given shapes, keeping the order of the rest
+	void remove(const set<int>& shapes);
+
+	// collapses shapes of the same kind and colour whose vertices agree
+	// once rounded to multiples of quantum (for polygons whatever vertex
+	// they start at and in either direction) to the first of them, and removes shapes of
+	// area under minArea.  quantum<=0 leaves duplicates alone.  Returns the
+	// number of shapes removed; the rest keep their order.
+	int dedup(double quantum, double minArea);
+	// area of shape i, positive for counterclockwise vertices
+	double area(int i) const;
+
+	// index of the shape owning vertex v
+	int shapeOf(int v) const;
+
+	int offset(int i) const { return _offsets[i]; }
+	int count(int i) const { return _counts[i]; }
+	TGShape kind(int i) const { return (TGShape) _kinds[i]; }
+	unsigned int packedColor(int i) const { return _colors[i]; }
+	Color color(int i) const { return unpackColor(_colors[i]); }
+
+	Pt2 pt(int v) const { return Pt2(_xs[v],_ys[v]); }
+	void setPt(int v, const Pt2& p) { _xs[v] = p[0]; _ys[v] = p[1]; }
+
+	double* xs() { return _xs.empty() ? NULL : &_xs[0]; }
+	double* ys() { return _ys.empty() ? NULL : &_ys[0]; }
+	const double* xs() const { return _xs.empty() ? NULL : &_xs[0]; }
+	const double* ys() const { return _ys.empty() ? NULL : &_ys[0]; }
+
+	// a Circ2 rather than a polygon; circles from older files are polygons
+	// of many vertices and stay so
+	bool isEllipse(int i) const { return _kinds[i]==TG_CIRC && _counts[i]==3; }
+
+	bool isPtInterior(int i, const Pt2& p) const {
+		if(isEllipse(i)){
+			int o = _offsets[i];
+			return Utils::isPtInEllipse(pt(o),pt(o+1)-pt(o),pt(o+2)-pt(o),p);
+		}
+		return Utils::isPtInterior(&_xs[_offsets[i]],&_ys[_offsets[i]],_counts[i],p);
+	}
+
+	// box (minx,miny,maxx,maxy) around shape i
+	void bounds(int i, double* b) const;
+	// vertices in the outline of shape i drawn at the given pixel size,
+	// after m if given: count(i) for polygons, more for bigger ellipses
+	int outlineSize(int i, double pixel, const Affine::Map* m=NULL) const;
+	// the n vertices, from outlineSize, of the outline of shape i
+	void outline(int i, int n, double* xs, double* ys) const;
+
+	static unsigned int packColor(const Color& c);
+	static Color unpackColor(unsigned int c);
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "Rendering/GeometryViewer.h"
 #include "Common/TinyGeom.h" 
 #include <FL/gl.h> 
+#include <FL/fl_ask.H>
 #include <GL/glu.h>
 
 #include <iostream>
@@ -13,24 +14,30 @@ extern "C" {
 using namespace TinyGeom;
 
 GeometryViewer::GeometryViewer(int x, int y, int w, int h, const char* l)
-	: Fl_Gl_Window(x, y, w, h, l) {
-	Fl::repeat_timeout(REFRESH_RATE, GeometryViewer::updateCb, this);
+	: Fl_Gl_Window(x, y, w, h, l), _redraw(this), _stats("GeometryViewer") {
 	_w = w;
 	_h = h;
-	_selected = NULL;
-	_highlighted = NULL;
-	_selectedPt = NULL;
-	_highlightedPt = NULL;
+	_selected = -1;
+	_highlighted = -1;
+	_selectedPt = -1;
+	_highlightedPt = -1;
 	_transgrid = NULL;
-	_geomhist.pushNew();
+	_density = NULL;
+	_densityTex = 0;
+	_densityDirty = false;
+	_viewCb = NULL;
+	_viewData = NULL;
+	_pick.build(_geomhist.pushNew());
+	_cull.build(_geomhist.getTop());
 	this->border(5);
 
 	defaultView();
+	buildFill(_geomhist.getTop());
 	_showGrid = true;
 }
 
 GeometryViewer::~GeometryViewer() {
-	Fl::remove_timeout(GeometryViewer::updateCb, this);
+	delete _density;
 }
 
 void GeometryViewer::set2DProjection() {
@@ -43,7 +50,25 @@ void GeometryViewer::set2DProjection() {
 	glLoadIdentity();
 }
 
+// the outline of shape i of gb at the given pixel size, after m if given;
+// ellipses are tessellated into ex, ey.  Sets xs, ys and returns the size.
+static int shapeOutline(const GeometryBatch& gb, int i, double pixel, const Affine::Map* m,
+	vector<double>& ex, vector<double>& ey, const double*& xs, const double*& ys) {
+	int n = gb.outlineSize(i, pixel, m);
+	xs = gb.xs() + gb.offset(i);
+	ys = gb.ys() + gb.offset(i);
+	if (gb.isEllipse(i)) {
+		ex.resize(n);
+		ey.resize(n);
+		gb.outline(i, n, &ex[0], &ey[0]);
+		xs = &ex[0];
+		ys = &ey[0];
+	}
+	return n;
+}
+
 void GeometryViewer::draw() {
+	ScopedTimer timer(&_stats, ST_DRAW);
 	if (!valid())
 		init();
 	//	this->make_current(); 
@@ -55,72 +80,208 @@ void GeometryViewer::draw() {
 
 	glColor3f(1.f, 1.f, 1.f);
 	if (_transgrid && _showGrid) {
-		const list<pair<int, int> >& edges = _transgrid->getEdges();
-		const vector<Pt2>& pts = _transgrid->getPts();
+		_stats.count(SC_VERTS, VertexBatch::draw(GL_LINES, _transgrid->getLines()));
+	}
 
-		glBegin(GL_LINES);
-		for (list<pair<int, int> >::const_iterator i = edges.begin(); i != edges.end(); i++) {
-			glVertex2d(pts[i->first][0], pts[i->first][1]);
-			glVertex2d(pts[i->second][0], pts[i->second][1]);
-		}
-		glEnd();
+
+	if (_density) {
+		drawDensity();
+		finishFrame(timer);
+		return;
 	}
 
+	// generations made by Apply, below the shapes that can still be edited
+	vector<ImplicitIFS*>* parts = _geomhist.getTopImplicit();
+	for (int j = 0; j < (int)parts->size(); j++)
+		drawImplicit((*parts)[j]);
+
+	// only the shapes in view, those under a pixel as dots
+	GeometryBatch* geoms = _geomhist.getTop();
+	double pixel = (_dspaceUR[0] - _dspaceLL[0]) / getWidth();
+	if ((int)_fillFirst.size() != geoms->size() + 1
+		|| (_fillEllipses && (pixel > 2 * _fillPixel || pixel < .5 * _fillPixel)))
+		buildFill(geoms);
+	vector<int> visible;
+	vector<ImplicitIFS::Dot> dots;
+	_cull.query(_dspaceLL, _dspaceUR, pixel, visible, dots);
+
+	// visible comes in index order, and shapes next to each other in it
+	// are next to each other in _fill
+	for (int k = 0; k < (int)visible.size();) {
+		int first = visible[k];
+		int last = first;
+		while (++k < (int)visible.size() && visible[k] == last + 1)
+			last++;
+		int from = _fillFirst[first];
+		_stats.count(SC_VERTS, _fill.draw(GL_TRIANGLES, from, _fillFirst[last + 1] - from));
+	}
 
-	glColor3f(1.f, 0.f, 0.f);
-	for (list<pair<Geom2*, Color> >::iterator i = _geomhist.getTop()->begin(); i != _geomhist.getTop()->end(); i++) {
-		Color c = i->second;
-		Geom2* g = i->first;
-		glColor3d(c[0], c[1], c[2]);
-		glBegin(GL_POLYGON);
-		for (int j = 0; j < g->size(); j++) {
-			Pt2* p = g->get(j);
-			glVertex2d((*p)[0], (*p)[1]);
-		}
+	// outlines on top, in a second small batch
+	vector<double> ex, ey;
+	const double* xs;
+	const double* ys;
+	_outlines.clear((_dspaceLL + _dspaceUR) * .5);
+	for (set<int>::iterator e = _editing.begin(); e != _editing.end(); e++) {
+		if (*e >= geoms->size()) continue;
+		int n = shapeOutline(*geoms, *e, pixel, NULL, ex, ey, xs, ys);
+		_outlines.addLoop(xs, ys, n, 0xff00ff00); // green
+	}
+	int editVerts = _outlines.size();
+	if (_highlighted >= 0 && _highlighted < geoms->size()) {
+		int n = shapeOutline(*geoms, _highlighted, pixel, NULL, ex, ey, xs, ys);
+		_outlines.addLoop(xs, ys, n, 0xff0000ff); // red
+	}
+	glLineWidth(3.f);
+	_outlines.draw(GL_LINES, 0, editVerts);
+	glLineWidth(2.f);
+	_outlines.draw(GL_LINES, editVerts);
+	glLineWidth(1.f);
+
+	drawDots(dots);
+	_stats.count(SC_VERTS, dots.size());
+
+	if (_highlightedPt >= 0) {
+		glBegin(GL_POINTS);
+		glColor3f(1, 0, 0);
+		glVertex2d(geoms->xs()[_highlightedPt], geoms->ys()[_highlightedPt]);
 		glEnd();
+	}
 
-		if (_editing.find(g) != _editing.end()) {
-			glLineWidth(3.f);
-			glColor3f(0., 1., 0);
-			glBegin(GL_LINE_LOOP);
-			for (int j = 0; j < g->size(); j++) {
-				Pt2* p = g->get(j);
-				glVertex2d((*p)[0], (*p)[1]);
-			}
-			glEnd();
-			glLineWidth(1.f);
-		}
+	finishFrame(timer);
+}
 
-		if (g == _highlighted) {
-			glLineWidth(2.f);
-			glColor3f(1., 0, 0);
-			glBegin(GL_LINE_LOOP);
-			for (int j = 0; j < g->size(); j++) {
-				Pt2* p = g->get(j);
-				glVertex2d((*p)[0], (*p)[1]);
-			}
-			glVertex2d((*g->get(0))[0], (*g->get(0))[1]);
-			glEnd();
-			glLineWidth(1.f);
+void GeometryViewer::finishFrame(ScopedTimer& drawTimer) {
+	drawTimer.stop();
+	_stats.endFrame();
+	_stats.drawOverlay(getWidth(), getHeight());
+	swap_buffers();
+}
+
+void GeometryViewer::buildFill(const GeometryBatch* gb) {
+	double pixel = (_dspaceUR[0] - _dspaceLL[0]) / getWidth();
+	_fillPixel = pixel;
+	_fillEllipses = false;
+	_fillFirst.resize(gb->size() + 1);
+
+	// the middle of the shapes as origin keeps the floats precise
+	Pt2 origin(0, 0);
+	if (gb->numVerts() > 0) {
+		const double* gx = gb->xs();
+		const double* gy = gb->ys();
+		double minx = gx[0], maxx = gx[0], miny = gy[0], maxy = gy[0];
+		for (int j = 1; j < gb->numVerts(); j++) {
+			minx = min(minx, gx[j]);
+			maxx = max(maxx, gx[j]);
+			miny = min(miny, gy[j]);
+			maxy = max(maxy, gy[j]);
 		}
+		origin = Pt2((minx + maxx) * .5, (miny + maxy) * .5);
+	}
+	_fill.clear(origin);
+
+	vector<double> ex, ey;
+	const double* xs;
+	const double* ys;
+	for (int i = 0; i < gb->size(); i++) {
+		_fillFirst[i] = _fill.size();
+		int n = shapeOutline(*gb, i, pixel, NULL, ex, ey, xs, ys);
+		_fill.addPolygon(xs, ys, n, gb->packedColor(i) | 0xff000000);
+		if (gb->isEllipse(i))
+			_fillEllipses = true;
+	}
+	_fillFirst[gb->size()] = _fill.size();
+}
 
-		for (int j = 0; j < g->size(); j++) {
-			Pt2* p = g->get(j);
-			if (p == _highlightedPt) {
-				glBegin(GL_POINTS);
-				glColor3f(1, 0, 0);
+void GeometryViewer::refill(int i) {
+	GeometryBatch* gb = _geomhist.getTop();
+	if (i < 0 || i + 1 >= (int)_fillFirst.size())
+		return;
+
+	vector<double> ex, ey;
+	const double* xs;
+	const double* ys;
+	int n = shapeOutline(*gb, i, _fillPixel, NULL, ex, ey, xs, ys);
+	// a resized ellipse can need another number of segments
+	if (VertexBatch::polygonSize(n) != _fillFirst[i + 1] - _fillFirst[i])
+		buildFill(gb);
+	else
+		_fill.setPolygon(_fillFirst[i], xs, ys, n, gb->packedColor(i) | 0xff000000);
+}
 
-				glVertex2d((*p)[0], (*p)[1]);
-				glEnd();
-			}
+void GeometryViewer::drawImplicit(const ImplicitIFS* ifs) {
+	vector<Affine::Map> leaves;
+	vector<ImplicitIFS::Dot> dots;
+	double pixel = (_dspaceUR[0] - _dspaceLL[0]) / getWidth();
+	int collapsed = ifs->traverse(_dspaceLL, _dspaceUR, pixel, IMPLICIT_NODE_BUDGET, leaves, dots);
+	_stats.count(SC_VERTS, dots.size());
+	_stats.count(SC_COLLAPSED, collapsed);
+
+	// every leaf's copy of the seed is mapped here and all of them go to
+	// GL in one call; ellipses are tessellated for their size after the map
+	const GeometryBatch& seed = ifs->seed();
+	vector<double> ex, ey;
+	const double* xs;
+	const double* ys;
+	_leaves.clear((_dspaceLL + _dspaceUR) * .5);
+	for (int l = 0; l < (int)leaves.size(); l++) {
+		for (int i = 0; i < seed.size(); i++) {
+			int n = shapeOutline(seed, i, pixel, &leaves[l], ex, ey, xs, ys);
+			_leaves.addPolygon(xs, ys, n, seed.packedColor(i) | 0xff000000, &leaves[l]);
 		}
 	}
+	_stats.count(SC_VERTS, _leaves.draw(GL_TRIANGLES));
 
-	swap_buffers();
+	// subtrees under a pixel, or past the node budget
+	drawDots(dots);
+}
+
+void GeometryViewer::drawDots(const vector<ImplicitIFS::Dot>& dots) {
+	if (dots.empty()) return;
+	_points.clear((_dspaceLL + _dspaceUR) * .5);
+	for (int d = 0; d < (int)dots.size(); d++)
+		_points.addPoint(dots[d].p, dots[d].color | 0xff000000);
+	glPointSize(1.f);
+	_points.draw(GL_POINTS);
+	glPointSize(8.f);
+}
+
+void GeometryViewer::drawDensity() {
+	int w = _density->width();
+	int h = _density->height();
+	if (_densityTex == 0)
+		glGenTextures(1, &_densityTex);
+	glBindTexture(GL_TEXTURE_2D, _densityTex);
+	if (_densityDirty) {
+		vector<unsigned char> rgba(4 * w * h);
+		_density->toRGBA(&rgba[0], Color(1, 1, 1));
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+		_densityDirty = false;
+	}
+
+	// texture row 0 is the top of the histogram
+	const Pt2& ll = _density->ll();
+	const Pt2& ur = _density->ur();
+	glEnable(GL_TEXTURE_2D);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	glBegin(GL_QUADS);
+	glTexCoord2d(0, 1); glVertex2d(ll[0], ll[1]);
+	glTexCoord2d(1, 1); glVertex2d(ur[0], ll[1]);
+	glTexCoord2d(1, 0); glVertex2d(ur[0], ur[1]);
+	glTexCoord2d(0, 0); glVertex2d(ll[0], ur[1]);
+	glEnd();
+	glDisable(GL_BLEND);
+	glDisable(GL_TEXTURE_2D);
 }
 
 Pt2 GeometryViewer::win2Screen(int x, int y) {
-	Vec2 winv(x / (double)getWidth(), (getHeight() - y) / (double)getHeight(), 0);
+	Vec2 winv(x / (double)getWidth(), (getHeight() - y) / (double)getHeight());
 	Vec2 diff = _dspaceUR - _dspaceLL;
 	diff[0] *= winv[0];
 	diff[1] *= winv[1];
@@ -129,21 +290,27 @@ Pt2 GeometryViewer::win2Screen(int x, int y) {
 }
 
 int GeometryViewer::handle(int ev) {
+	// a plain mouse move only needs a redraw if the highlight changes
+	int oldHighlighted = _highlighted;
+	int oldHighlightedPt = _highlightedPt;
+	if (ev == FL_PUSH || ev == FL_DRAG || ev == FL_RELEASE)
+		requestRedraw();
+
 	// input in 2d mode
 	if (ev == FL_PUSH) {
 		if (Fl::event_button() == FL_LEFT_MOUSE) {
 			_prevpos = win2Screen(Fl::event_x(), Fl::event_y());
-			if (_highlighted) {
+			if (_highlighted >= 0) {
 				_selected = _highlighted;
 			}
-			else if (_highlightedPt) {
+			else if (_highlightedPt >= 0) {
 				_selectedPt = _highlightedPt;
 			}
 			else
 				_panning = true;
 		}
 		else if (Fl::event_button() == FL_RIGHT_MOUSE) {
-			if (!_highlighted && !_highlightedPt) {
+			if (_highlighted < 0 && _highlightedPt < 0) {
 				_prevpos = Pt2(Fl::event_x(), Fl::event_y());
 				_zooming = true;
 			}
@@ -153,44 +320,41 @@ int GeometryViewer::handle(int ev) {
 	else if (ev == FL_DRAG) {
 		if (Fl::event_button() == FL_LEFT_MOUSE) {
 			Pt2 mpos = win2Screen(Fl::event_x(), Fl::event_y());
-			if (_selected) {
+			GeometryBatch* geoms = _geomhist.getTop();
+			if (_selected >= 0) {
 				Vec2 v = mpos - _prevpos;
-				for (int j = 0; j < _selected->size(); j++) {
-					(*_selected->get(j))[0] += v[0];
-					(*_selected->get(j))[1] += v[1];
+				int off = geoms->offset(_selected);
+				for (int j = off; j < off + geoms->count(_selected); j++) {
+					geoms->setPt(j, geoms->pt(j) + v);
 				}
+				_geomhist.topChanged();
+				_pick.moved(_selected);
+				_cull.moved(_selected);
+				refill(_selected);
 				_prevpos = mpos;
 			}
-			else if (_selectedPt) {
-				Geom2* g2 = _p2geom[_selectedPt];
-				Quad2* quad = dynamic_cast<Quad2*>(g2);
-				Hex2* hex = dynamic_cast<Hex2*>(g2);
-				Circ2* circ = dynamic_cast<Circ2*>(g2);
-				Oct2* oct = dynamic_cast<Oct2*>(g2);
-				Pent2* pent = dynamic_cast<Pent2*>(g2);
+			else if (_selectedPt >= 0) {
+				int g2 = geoms->shapeOf(_selectedPt);
+				int off = geoms->offset(g2);
+				int n = geoms->count(g2);
+				TGShape kind = geoms->kind(g2);
 				// TODO: add more shapes
 
-				if (quad) {
+				if (kind == TG_QUAD) {
 					Vec2 v = mpos - _prevpos;
-					Pt2 prevp = (*_selectedPt);
-					(*_selectedPt)[0] += v[0];
-					(*_selectedPt)[1] += v[1];
-
-					int aind, bind, cind, dind;
-					for (int j = 0; j < quad->size(); j++) {
-						if (quad->get(j) == _selectedPt) {
-							aind = j;
-							break;
-						}
-					}
-					bind = (aind + 1) % 4;
-					cind = (aind + 2) % 4;
-					dind = (aind + 3) % 4;
+					Pt2 prevp = geoms->pt(_selectedPt);
+					geoms->setPt(_selectedPt, prevp + v);
+
+					int aind = _selectedPt - off;
+					int bind = off + (aind + 1) % 4;
+					int cind = off + (aind + 2) % 4;
+					int dind = off + (aind + 3) % 4;
+					aind += off;
 
-					Vec2 ba = (*quad->get(bind)) - prevp;
-					Vec2 ca = (*quad->get(cind)) - (*quad->get(aind));
-					Vec2 ac = (*quad->get(aind)) - (*quad->get(cind));
-					Vec2 dc = (*quad->get(dind)) - (*quad->get(cind));
+					Vec2 ba = geoms->pt(bind) - prevp;
+					Vec2 ca = geoms->pt(cind) - geoms->pt(aind);
+					Vec2 ac = geoms->pt(aind) - geoms->pt(cind);
+					Vec2 dc = geoms->pt(dind) - geoms->pt(cind);
 
 					double len0 = ca * ba / mag(ba);
 					double len1 = ac * dc / mag(dc);
@@ -198,54 +362,76 @@ int GeometryViewer::handle(int ev) {
 					dc.normalize();
 					ba.normalize();
 
-					(*quad->get(dind)) = (*quad->get(cind)) + (len1 * dc);
-					(*quad->get(bind)) = (*quad->get(aind)) + (len0 * ba);
+					geoms->setPt(dind, geoms->pt(cind) + (len1 * dc));
+					geoms->setPt(bind, geoms->pt(aind) + (len0 * ba));
+				}
+				else if (geoms->isEllipse(g2)) {
+					// the centre moves the ellipse, the other two points
+					// scale it about the centre
+					Pt2 center = geoms->pt(off);
+					if (_selectedPt == off) {
+						Vec2 v = mpos - _prevpos;
+						for (int j = off; j < off + n; j++)
+							geoms->setPt(j, geoms->pt(j) + v);
+					}
+					else {
+						double r = mag(geoms->pt(_selectedPt) - center);
+						double s = r > 0 ? mag(mpos - center) / r : 1;
+						for (int j = off + 1; j < off + n; j++)
+							geoms->setPt(j, center + (geoms->pt(j) - center) * s);
+					}
 				}
-				else if (hex || oct || circ) {
-					Vec2 centerZero = ((*g2->get(g2->size() / 2)) - (*g2->get(0))) * 0.5;
-					Pt2 center = (*g2->get(0)) + centerZero;
+				else if (kind == TG_HEX || kind == TG_OCT || kind == TG_CIRC) {
+					Vec2 centerZero = (geoms->pt(off + n / 2) - geoms->pt(off)) * 0.5;
+					Pt2 center = geoms->pt(off) + centerZero;
 					double r = mag(centerZero);
 
 					double s = mag(mpos - center) / r;
 
-					for (int j = 0; j < g2->size(); j++) {
-						Vec2 distfromCenter = ((*g2->get(j)) - center) * s;
-						(*g2->get(j)) = center + distfromCenter;
+					for (int j = off; j < off + n; j++) {
+						Vec2 distfromCenter = (geoms->pt(j) - center) * s;
+						geoms->setPt(j, center + distfromCenter);
 					}
 				}
-				else if (pent) {
-					Vec2 zTo = (*pent->get(1)) - (*pent->get(0));
+				else if (kind == TG_PENT) {
+					Vec2 zTo = geoms->pt(off + 1) - geoms->pt(off);
 					double len = mag(zTo);
 					double r = len / sqrt(2 * (1 - cos(72 * M_PI / 180)));
 
-					Pt2 midp = (*pent->get(0)) + (zTo * 0.5);
-					Vec2 threeMidPoint = midp - (*pent->get(3));
+					Pt2 midp = geoms->pt(off) + (zTo * 0.5);
+					Vec2 threeMidPoint = midp - geoms->pt(off + 3);
 					Vec2 threeCenter = threeMidPoint * (r / mag(threeMidPoint));
-					Pt2 center = (*pent->get(3)) + threeCenter;
+					Pt2 center = geoms->pt(off + 3) + threeCenter;
 
 
 					double s = mag(mpos - center) / r;
 
-					for (int j = 0; j < g2->size(); j++) {
-						Vec2 distfromCenter = ((*g2->get(j)) - center) * s;
-						(*g2->get(j)) = center + distfromCenter;
+					for (int j = off; j < off + n; j++) {
+						Vec2 distfromCenter = (geoms->pt(j) - center) * s;
+						geoms->setPt(j, center + distfromCenter);
 					}
 				}
 				else {
 					// else it is a triangle.  
 					Vec2 v = mpos - _prevpos;
-					(*_selectedPt) += v;
+					Pt2 prevp = geoms->pt(_selectedPt);
+					geoms->setPt(_selectedPt, prevp + v);
 
-					if (!Utils::isConvex(g2))
-						(*_selectedPt) -= v;
+					if (!Utils::isConvex(geoms->xs() + off, geoms->ys() + off, n))
+						geoms->setPt(_selectedPt, prevp);
 				}
 
+				_geomhist.topChanged();
+				_pick.moved(g2);
+				_cull.moved(g2);
+				refill(g2);
 				_prevpos = mpos;
 			}
 			else if (_panning) {
 				Vec2 change = mpos - _prevpos;
 				_dspaceLL -= change;
 				_dspaceUR -= change;
+				viewChanged();
 			}
 		}
 		else if (Fl::event_button() == FL_RIGHT_MOUSE) {
@@ -260,12 +446,13 @@ int GeometryViewer::handle(int ev) {
 				_dspaceLL = center + (fac * lv);
 				_dspaceUR = center + (fac * rv);
 				_prevpos = mpos;
+				viewChanged();
 			}
 		}
 	}
 	else if (ev == FL_RELEASE) {
 		if (Fl::event_button() == FL_RIGHT_MOUSE) {
-			if (_highlighted) {
+			if (_highlighted >= 0) {
 				if (_editing.find(_highlighted) == _editing.end()) {
 					_editing.insert(_highlighted);
 				}
@@ -275,14 +462,20 @@ int GeometryViewer::handle(int ev) {
 			}
 		}
 
-		_selected = NULL;
-		_highlighted = NULL;
-		_selectedPt = NULL;
-		_highlightedPt = NULL;
+		if (_pick.stale())
+			_pick.build(_geomhist.getTop());
+
+		_selected = -1;
+		_highlighted = -1;
+		_selectedPt = -1;
+		_highlightedPt = -1;
 		_panning = false;
 		_zooming = false;
 	}
+	else if (ev == FL_MOVE && _density) {}
 	else if (ev == FL_MOVE) {
+		ScopedTimer timer(&_stats, ST_PICK);
+		long long tests = _pick.tests();
 		Pt2 mpos = win2Screen(Fl::event_x(), Fl::event_y());
 		double ratio = Utils::dist2d(_dspaceLL, _dspaceUR) / 600;
 
@@ -290,30 +483,23 @@ int GeometryViewer::handle(int ev) {
 		// check to see if the mouse is interior to some shape
 		// isPtInterior only works for convex shapes.
 		// if your shape is not-convex, you need to write a different function to check for interior-ness.
-		_highlighted = NULL;
-		for (list<pair<Geom2*, Color> >::reverse_iterator i = _geomhist.getTop()->rbegin(); i != _geomhist.getTop()->rend(); i++) {
-			if (Utils::isPtInterior(i->first, mpos)) {
-				_highlighted = i->first;
-				break;
-			}
-		}
+		_highlighted = _pick.shapeAt(mpos);
 
-		_highlightedPt = NULL;
-		if (!_highlighted) {
-			double bestd = 10000;
-			Pt2* best = NULL;
-			for (map<Pt2*, Geom2*>::iterator i = _p2geom.begin(); i != _p2geom.end(); i++) {
-				double nd = Utils::dist2d(*(i->first), mpos);
-				if (nd < bestd) {
-					bestd = nd;
-					best = i->first;
-				}
-			}
-			if (best && bestd < 5 * ratio)
-				_highlightedPt = best;
+		_highlightedPt = -1;
+		if (_highlighted < 0)
+			_highlightedPt = _pick.closestVertex(mpos, 5 * ratio);
+		_stats.count(SC_HITTESTS, _pick.tests() - tests);
+
+		if (_highlighted != oldHighlighted || _highlightedPt != oldHighlightedPt)
+			requestRedraw();
+	}
+	else if (ev == FL_KEYDOWN || ev == FL_SHORTCUT) {
+		// shortcuts reach the viewer under the mouse without the focus
+		if (_stats.handleKey(Fl::event_key(), Fl::event_state(FL_SHIFT) != 0)) {
+			requestRedraw();
+			return 1;
 		}
 	}
-	else if (ev == FL_KEYDOWN) {}
 	else if (ev == FL_KEYUP) {}
 
 	return Fl_Gl_Window::handle(ev);
@@ -339,6 +525,8 @@ void GeometryViewer::resize(int x, int y, int width, int height) {
 	_w = width;
 	_h = height;
 	Fl_Gl_Window::resize(x, y, width, height);
+	viewChanged();
+	requestRedraw();
 }
 
 void GeometryViewer::addGeom(Geom2* geom) {
@@ -350,11 +538,15 @@ void GeometryViewer::addGeom(Geom2* geom) {
 	g = min(1, g + .2);
 	b = min(1, b + .2);
 
-	_geomhist.getTop()->push_back(make_pair(geom, Color(r, g, b)));
-	for (int j = 0; j < geom->size(); j++)
-		_p2geom[geom->get(j)] = geom;
+	_geomhist.getTop()->add(geom, Color(r, g, b));
+	_geomhist.topChanged();
+	delete geom;
+	setDensity(NULL);
+	_pick.build(_geomhist.getTop());
+	_cull.build(_geomhist.getTop());
+	buildFill(_geomhist.getTop());
 
-	redraw();
+	requestRedraw();
 }
 
 void GeometryViewer::saveImageBufferCb(Fl_Widget* widget, void* userdata) {
@@ -371,18 +563,137 @@ void GeometryViewer::saveImageBufferCb(Fl_Widget* widget, void* userdata) {
 		GLubyte* data = new GLubyte[4 * h * w];
 		glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, data);
 
-		bmpfile_t* bfile = bmp_create(w, h, 32);
-		for (int j = 0; j < h; j++) {
-			for (int i = 0; i < w; i++) {
-				rgb_pixel_t pix = { data[(j * w + i) * 4 + 2],data[(j * w + i) * 4 + 1],data[(j * w + i) * 4],data[(j * w + i) * 4 + 3] };
-				bmp_set_pixel(bfile, i, (h - 1) - j, pix);
+		// gl rows go bottom up like the file's, so they are written as they are
+		if (!bmp_save_buffer(newfile, w, h, 32, data, BMP_RGBA, TRUE))
+			cout << "could not write " << newfile << endl;
+
+		delete[] data;
+
+	}
+}
+
+void GeometryViewer::renderTile(SoftRaster& tile) {
+	const Pt2& ll = tile.ll();
+	const Pt2& ur = tile.ur();
+	double pixel = (ur[0] - ll[0]) / tile.width();
+
+	// same order as draw(): the implicit parts, then the editable batch
+	const vector<ImplicitIFS*>* parts = _geomhist.getTopImplicit();
+	vector<double> xs, ys;
+	for (int p = 0; p < (int)parts->size(); p++) {
+		const ImplicitIFS* ifs = (*parts)[p];
+		vector<Affine::Map> leaves;
+		vector<ImplicitIFS::Dot> dots;
+		ifs->traverse(ll, ur, pixel, IMPLICIT_NODE_BUDGET, leaves, dots);
+
+		const GeometryBatch& seed = ifs->seed();
+		for (int l = 0; l < (int)leaves.size(); l++) {
+			for (int i = 0; i < seed.size(); i++) {
+				int n = seed.outlineSize(i, pixel, &leaves[l]);
+				xs.resize(n);
+				ys.resize(n);
+				seed.outline(i, n, &xs[0], &ys[0]);
+				for (int j = 0; j < n; j++) {
+					Pt2 q = Affine::apply(leaves[l], Pt2(xs[j], ys[j]));
+					xs[j] = q[0];
+					ys[j] = q[1];
+				}
+				tile.fillPolygon(&xs[0], &ys[0], n, seed.packedColor(i));
 			}
 		}
-		bmp_save(bfile, newfile);
-		bmp_destroy(bfile);
+		for (int d = 0; d < (int)dots.size(); d++)
+			tile.plot(dots[d].p, dots[d].color);
+	}
 
-		delete[] data;
+	tile.drawBatch(*_geomhist.getTop(), false);
+}
+
+void GeometryViewer::exportTiledCb(Fl_Widget* widget, void* userdata) {
+	GeometryViewer* viewer = (GeometryViewer*)userdata;
+
+	if (viewer) {
+		char* newfile = fl_file_chooser("Export image", ".bmp (*.bmp)", "./images", 0);
+		if (!newfile) return;
+		string filename(newfile);
+
+		// the window on screen, at any width; the height keeps its aspect
+		const char* input = fl_input("Width in pixels", "8192");
+		if (!input) return;
+		int w = (int)Str::parseInt(input);
+		int h = (int)(w * (double)viewer->getHeight() / viewer->getWidth() + .5);
+		if (w < 1 || h < 1) return;
+
+		WorkerPool pool(WorkerPool::defaultThreads());
+		bool ok = saveTiled(filename.c_str(), w, h, viewer->_dspaceLL, viewer->_dspaceUR, Color(0, 0, 0),
+			[viewer](SoftRaster& tile) { viewer->renderTile(tile); }, &pool);
+		if (!ok)
+			cout << "could not write " << filename << " (" << w << "x" << h << ")" << endl;
+	}
+}
 
+void GeometryViewer::saveDensityCb(Fl_Widget* widget, void* userdata) {
+	GeometryViewer* viewer = (GeometryViewer*)userdata;
+
+	if (viewer && viewer->_density) {
+		char* newfile = fl_file_chooser("Save density", ".bmp (*.bmp)", "./images", 0);
+		if (!newfile) return;
+
+		if (!viewer->_density->save(newfile, Color(1, 1, 1)))
+			cout << "could not write " << newfile << endl;
+	}
+}
+
+void GeometryViewer::saveGeomCb(Fl_Widget* widget, void* userdata) {
+	GeometryViewer* viewer = (GeometryViewer*)userdata;
+
+	if (viewer) {
+		// the implicit parts are written out shape by shape, under them the
+		// editable batch as usual
+		vector<ImplicitIFS*>* parts = viewer->_geomhist.getTopImplicit();
+		GeometryBatch* top = viewer->_geomhist.getTop();
+		double nverts = top->numVerts();
+		for (int j = 0; j < (int)parts->size(); j++)
+			nverts += (*parts)[j]->numShapes() * (*parts)[j]->seed().numVerts() / max((*parts)[j]->seed().size(), 1);
+		if (nverts > SCENE_MAX_VERTS) {
+			cout << "too many shapes to save, undo some applies first" << endl;
+			return;
+		}
+
+		char* newfile = fl_file_chooser("Save geometry", ".ifsb (*.ifsb)", "./files", 0);
+		if (!newfile) return;
+
+		GeometryBatch all;
+		int collapsed = 0;
+		for (int j = 0; j < (int)parts->size(); j++)
+			collapsed += (*parts)[j]->expand(all);
+		if (collapsed > 0)
+			cout << collapsed << " duplicate or degenerate subtrees left out" << endl;
+		Affine::Map id = { 1, 0, 0, 1, 0, 0 };
+		all.addImages(*top, &id, 1);
+
+		if (!SceneFile::write(newfile, NULL, &all))
+			cout << "could not write " << newfile << endl;
+	}
+}
+
+void GeometryViewer::openGeomCb(Fl_Widget* widget, void* userdata) {
+	GeometryViewer* viewer = (GeometryViewer*)userdata;
+
+	if (viewer) {
+		char* newfile = fl_file_chooser("Open geometry", ".ifsb (*.ifsb)", "./files", 0);
+		if (!newfile) return;
+
+		SceneFile scene;
+		if (!scene.open(newfile) || !scene.hasGeometry()) {
+			cout << newfile << " holds no geometry" << endl;
+			return;
+		}
+		// a new generation, so undo goes back to what was there before.
+		// Nothing rebuilds a scene, so the history keeps it resident until
+		// an implicit Apply on it can; read first so the trim sees its size
+		GeometryBatch* geoms = new GeometryBatch();
+		scene.readGeometry(*geoms);
+		viewer->prepareGeom(viewer->_geomhist.push(geoms));
 	}
 }
 
@@ -442,27 +753,20 @@ void GeometryViewer::undoCb(Fl_Widget* widget, void* userdata) {
 
 void GeometryViewer::defaultViewCb(Fl_Widget*, void* userdata) {
 	GeometryViewer* viewer = (GeometryViewer*)userdata;
-	if (viewer)
+	if (viewer) {
 		viewer->defaultView();
+		viewer->viewChanged();
+		viewer->requestRedraw();
+	}
 }
 
 
 void GeometryViewer::delEditingShapesCb(Fl_Widget* widget, void* userdata) {
 	GeometryViewer* viewer = (GeometryViewer*)userdata;
 	if (viewer) {
-		list<pair<Geom2*, Color> >* geoms = viewer->_geomhist.getTop();
-		list<pair<Geom2*, Color> > ngeoms;
-
-		for (list<pair<Geom2*, Color> >::iterator i = geoms->begin(); i != geoms->end(); i++) {
-			if (viewer->_editing.find(i->first) == viewer->_editing.end())
-				ngeoms.push_back(*i);
-		}
-		(*geoms) = ngeoms;
-
-		for (set<Geom2*>::iterator i = viewer->_editing.begin(); i != viewer->_editing.end(); i++)
-			delete* i;
-
-		viewer->_editing.clear();
+		GeometryBatch* geoms = viewer->_geomhist.getTop();
+		geoms->remove(viewer->_editing);
+		viewer->_geomhist.topChanged();
 		viewer->prepareGeom(geoms);
 	}
 }
\ No newline at end of file
@@ -9,9 +9,17 @@
 #include "Common/TinyGeom.h" 
 
 #include "GUI/Button.h" 
+#include "GUI/RedrawScheduler.h" 
+#include "GUI/FrameStats.h" 
 
 #include "Rendering/BaseGrid.h" 
 #include "Rendering/Manager.h" 
+#include "Rendering/DensityHistogram.h" 
+#include "Rendering/PickGrid.h" 
+#include "Rendering/BoundsTree.h" 
+#include "Rendering/SceneFile.h" 
+#include "Rendering/SoftRaster.h" 
+#include "Rendering/VertexBatch.h" 
 
 #include <list> 
 #include <map>
@@ -20,33 +28,69 @@
 using namespace std; 
 using namespace TinyGeom; 
 
-#define REFRESH_RATE .001
-
 class GeometryViewer : public Fl_Gl_Window{
 protected: 
 	int _w,_h; 
 
 	Pt2 _dspaceLL, _dspaceUR; // drawing space lower left corner and upper left corner
 
-	map<Pt2*,Geom2*> _p2geom; 
-	Geom2* _selected; 
-	Geom2* _highlighted; 
-	Pt2* _selectedPt; 
-	Pt2* _highlightedPt; 
+	// shapes are indices into the top GeometryBatch, points are vertex
+	// indices into the same batch; -1 means none
+	int _selected; 
+	int _highlighted; 
+	int _selectedPt; 
+	int _highlightedPt; 
 
 	bool _panning; 
 	bool _zooming; 
 	bool _showGrid; 
 
-	set<Geom2*> _editing; 
+	set<int> _editing; 
 	GeometryHistory _geomhist; 
+	PickGrid _pick; // over the top of _geomhist
+	BoundsTree _cull; // the same, for drawing only what is in view
+	// the same again as triangles, shape i from vertex _fillFirst[i] to
+	// _fillFirst[i+1], so a run of visible shapes is one draw call;
+	// ellipses are tessellated for the pixel size _fillPixel
+	VertexBatch _fill; 
+	vector<int> _fillFirst; 
+	double _fillPixel; 
+	bool _fillEllipses; // rebuilt when zooming changes the pixel size 2x
+	// refilled every frame
+	VertexBatch _outlines; 
+	VertexBatch _leaves; 
+	VertexBatch _points; 
 	Pt2 _prevpos; 
 
 	BaseGrid* _transgrid; 
+	RedrawScheduler _redraw; 
+	FrameStats _stats; // overlay toggled with p
+
+	// chaos game result, shown instead of the geometry while set
+	DensityHistogram* _density; 
+	GLuint _densityTex; 
+	bool _densityDirty; 
+
+	// told when the drawing-space window or the pixel size changes
+	typedef void (*ViewChangedCb)(void* userdata); 
+	ViewChangedCb _viewCb; 
+	void* _viewData; 
+	void viewChanged() { if(_viewCb) _viewCb(_viewData); }
+
 	inline int getWidth() { return _w; } 
 	inline int getHeight() { return _h; } 
 
 	void addGeom(Geom2* g); 
+	void buildFill(const GeometryBatch* gb); 
+	// shape i of the top batch changed
+	void refill(int i); 
+	void drawDensity(); 
+	void drawImplicit(const ImplicitIFS* ifs); 
+	void drawDots(const vector<ImplicitIFS::Dot>& dots); 
+	// stops the draw timer, adds the stats overlay and swaps
+	void finishFrame(ScopedTimer& drawTimer); 
+	// software version of draw() for one tile of an export
+	void renderTile(SoftRaster& tile); 
 	Pt2 win2Screen(int x, int y); 
 
 	void defaultView(){
@@ -66,30 +110,60 @@ public:
 	int handle(int flag); 
 	void init();
 
-	static void updateCb(void* userdata){
-		GeometryViewer* viewer = (GeometryViewer*) userdata; 
-		viewer->redraw(); 
-		Fl::repeat_timeout(REFRESH_RATE,GeometryViewer::updateCb,userdata);
-	}
+	// everything that changes what is on screen calls this instead of redraw()
+	void requestRedraw() { _redraw.request(); }
+	void setMaxFps(double fps) { _redraw.setMaxFps(fps); }
 
 	void setBaseGrid(BaseGrid* tg) { 
 		_transgrid = tg; 
+		_transgrid->addListener(gridChangedCb,this); 
 	}
+	static void gridChangedCb(void* userdata) { ((GeometryViewer*) userdata)->requestRedraw(); }
 
 	GeometryHistory* getGeomHistory() { return &_geomhist; }
 
 	void resize(int x, int y, int width, int height);
 	void set2DProjection(); 
 
-	void prepareGeom(list<pair<Geom2*,Color> >* lg){
+	// takes ownership; NULL goes back to showing the geometry
+	void setDensity(DensityHistogram* d){
+		if(d!=_density) delete _density; 
+		_density = d; 
+		_densityDirty = true; 
+		requestRedraw(); 
+	}
+	DensityHistogram* getDensity() { return _density; }
+
+	// one listener at a time, NULL for none
+	void setViewListener(ViewChangedCb cb, void* userdata) { _viewCb = cb; _viewData = userdata; }
+
+	// the pixel size and drawing-space window currently on screen
+	void getView(int& w, int& h, Pt2& ll, Pt2& ur){
+		w = getWidth(); 
+		h = getHeight(); 
+		ll = _dspaceLL; 
+		ur = _dspaceUR; 
+	}
+
+	void prepareGeom(GeometryBatch* gb){
+		ScopedTimer timer(&_stats,ST_PREPARE); 
+		setDensity(NULL); 
+		_pick.build(gb); 
+		_cull.build(gb); 
+		buildFill(gb); 
 		_editing.clear(); 
-		_p2geom.clear(); 
-		for(list<pair<Geom2*,Color> >::const_iterator i=lg->begin();i!=lg->end();i++)
-			for(int j=0;j<i->first->size();j++)
-				_p2geom[i->first->get(j)] = i->first; 
+		_selected = -1; 
+		_highlighted = -1; 
+		_selectedPt = -1; 
+		_highlightedPt = -1; 
+		requestRedraw(); 
 	}
 
 	static void saveImageBufferCb(Fl_Widget* widget,void* userdata); 
+	static void saveDensityCb(Fl_Widget* widget,void* userdata); 
+	static void exportTiledCb(Fl_Widget* widget,void* userdata); 
+	static void saveGeomCb(Fl_Widget* widget,void* userdata); 
+	static void openGeomCb(Fl_Widget* widget,void* userdata); 
 	static void addShapeCb(Fl_Widget* widget,void* userdata); 
 	static void delEditingShapesCb(Fl_Widget* widget,void* userdata); 
 	static void undoCb(Fl_Widget*, void* userdata); 
@@ -103,6 +177,7 @@ public:
 				b->label("Grid Off"); 
 			else
 				b->label("Grid On"); 
+			ov->requestRedraw(); 
 		}
 	}
 
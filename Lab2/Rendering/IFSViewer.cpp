@@ -5,6 +5,7 @@
 #include <FL/fl_draw.H> 
 #include <GL/glu.h>
 #include "GUI/PopUp.h"
+#include "Rendering/SceneFile.h"
 
 #include <iostream>
 #include <fstream> 
@@ -37,11 +38,111 @@ void IFSViewer::setAsEntry(TransformEntry* ent){
 		double b = min(1,rand()/(1.*RAND_MAX)+.1); 
 		viewer->_t2color[*i] = Color(r,g,b); 
 	}
+	viewer->geomChanged(); 
+}
+
+void IFSViewer::updatePick(){
+	if(!_pickDirty) return; 
+
+	_pickGeom.clear(); 
+	_pickTris.clear(); 
+	_pickIndex.clear(); 
+	list<Tri2*>* tris = _tentry->getGeoms(); 
+	for(list<Tri2*>::iterator i=tris->begin();i!=tris->end();i++){
+		_pickIndex[*i] = _pickGeom.add(*i,Color(1,1,1)); 
+		_pickTris.push_back(*i); 
+	}
+	_pick.build(&_pickGeom); 
+	_pickDirty = false; 
+}
+
+void IFSViewer::updateFill(){
+	if(!_fillDirty) return; 
+
+	_fill.clear(); 
+	list<Tri2*>* tris = _tentry->getGeoms(); 
+	for(list<Tri2*>::iterator i=tris->begin();i!=tris->end();i++){
+		Color color(.5,.5,.8); 
+		if(_t2color.find(*i)!=_t2color.end())
+			color = _t2color[*i]; 
+		color[3] = .7; 
+		double xs[3], ys[3]; 
+		for(int j=0;j<3;j++){
+			xs[j] = (*(*i)->get(j))[0]; 
+			ys[j] = (*(*i)->get(j))[1]; 
+		}
+		_fill.addPolygon(xs,ys,3,GeometryBatch::packColor(color)); 
+	}
+	_fillDirty = false; 
+}
+
+int IFSViewer::pickVertex(Pt2* p){
+	map<Pt2*,Tri2*>::iterator i = _tentry->getP2Geom()->find(p); 
+	if(i==_tentry->getP2Geom()->end() || !i->second) return -1; 
+
+	int s = pickShape(i->second); 
+	if(s<0) return -1; 
+	for(int j=0;j<i->second->size();j++)
+		if(i->second->get(j)==p)
+			return _pickGeom.offset(s)+j; 
+	return -1; 
+}
+
+Pt2* IFSViewer::closestPt(const Pt2& p, double radius, Tri2* skipTri, Pt2* skipPt, double& dist){
+	Pt2* best = NULL; 
+	int v = _pick.closestVertex(p,radius,skipTri ? pickShape(skipTri) : -1,skipPt ? pickVertex(skipPt) : -1,&dist); 
+	if(v>=0){
+		int s = _pickGeom.shapeOf(v); 
+		best = _pickTris[s]->get(v-_pickGeom.offset(s)); 
+	}
+
+	// the transformation center can be picked and snapped to like a corner
+	Pt2* tc = _tentry->getTransCenter(); 
+	if(tc!=skipPt){
+		double d = Utils::dist2d(*tc,p); 
+		if(d<dist){
+			dist = d; 
+			best = tc; 
+		}
+	}
+	return best; 
+}
+
+void IFSViewer::currentMaps(vector<Affine::Map>& maps, vector<Color>& colors){
+	list<Tri2*>* tris = _tentry->getGeoms(); 
+	for(list<Tri2*>::iterator i=tris->begin();i!=tris->end();i++){
+		Transformation t; 
+		t.setAs3PtTransform(*_tentry->getBase(),*(*i)); 
+		maps.push_back(Affine::fromMat3(*t.getmat())); 
+		if(_t2color.find(*i)!=_t2color.end())
+			colors.push_back(_t2color[*i]); 
+		else
+			colors.push_back(Color(.5,.5,.8)); 
+	}
+}
+
+void IFSViewer::updatePreview(){
+	if(!_preview) return; 
+
+	vector<Affine::Map> maps; 
+	vector<Color> colors; 
+	currentMaps(maps,colors); 
+	int w,h; 
+	Pt2 ll,ur; 
+	_previewView->getView(w,h,ll,ur); 
+	_preview->restart(maps,colors,w,h,ll,ur); 
+}
+
+void IFSViewer::previewReadyCb(void* userdata){
+	IFSViewer* tv = (IFSViewer*) userdata; 
+	if(!tv->_preview) return; // switched off in the meantime
+
+	DensityHistogram* hist = tv->_preview->take(); 
+	if(hist) tv->_previewView->setDensity(hist); 
 }
 
 IFSViewer::IFSViewer(int x, int y, int w, int h, const char* l)
-: Fl_Gl_Window(x,y,w,h,l){
-	Fl::repeat_timeout(REFRESH_RATE,IFSViewer::updateCb,this);
+: Fl_Gl_Window(x,y,w,h,l), _redraw(this), _stats("IFSViewer"){
 	_w = w; 
 	_h = h; 
 	_selected = NULL; 
@@ -51,6 +152,8 @@ IFSViewer::IFSViewer(int x, int y, int w, int h, const char* l)
 	_transgrid = NULL; 
 
 	_tbrowser = NULL; 
+	_pickDirty = true; 
+	_fillDirty = true; 
 	_tentry = _tmanager.newEntry("default"); 
 	Tri2* tri = _tentry->getBase(); 
 	(*tri->get(0)) = Pt2(0,0); 
@@ -62,10 +165,20 @@ IFSViewer::IFSViewer(int x, int y, int w, int h, const char* l)
 
 	_baseEdit = false; 
 	_doSnap = true;  
+
+	_pool = NULL; 
+	setThreadCount(WorkerPool::defaultThreads()); 
+	_chaos = NULL; 
+	_preview = NULL; 
+	_previewView = NULL; 
+	_dedup = false; 
+	_dedupArea = DEDUP_MIN_AREA; 
 }
 
 IFSViewer::~IFSViewer(){
-	Fl::remove_timeout(IFSViewer::updateCb,this); 
+	delete _preview; 
+	delete _pool; 
+	delete _chaos; 
 }
 
 void IFSViewer::init(){
@@ -96,6 +209,7 @@ void IFSViewer::set2DProjection(){
 }
 
 void IFSViewer::draw(){
+	ScopedTimer timer(&_stats,ST_DRAW); 
 	if(!valid())
 		init();
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -109,16 +223,8 @@ void IFSViewer::draw(){
 		else
 			glColor4d(1.,1,1,1); 
 
-		const list<pair<int,int> >& edges = _transgrid->getEdges(); 
-		const vector<Pt2>& pts = _transgrid->getPts(); 
 		Tri2* base = _tentry->getBase(); 
-
-		glBegin(GL_LINES); 
-		for(list<pair<int,int> >::const_iterator i=edges.begin(); i!=edges.end(); i++){
-			glVertex2d(pts[i->first][0],pts[i->first][1]); 
-			glVertex2d(pts[i->second][0],pts[i->second][1]); 
-		}
-		glEnd(); 
+		_stats.count(SC_VERTS,VertexBatch::draw(GL_LINES,_transgrid->getLines())); 
 
 		for(int j=0;j<base->size();j++){
 			glRasterPos2d((*base->get(j))[0]-(GCW[j]/2),
@@ -142,65 +248,52 @@ void IFSViewer::draw(){
 		}
 	}
 
-	list<Tri2*>* geom = _tentry->getGeoms(); 
-
-	for(list<Tri2*>::iterator i=geom->begin();i!=geom->end();i++){ 
-		glBegin(GL_POLYGON); 
-		if(_t2color.find(*i)!=_t2color.end()){
-			Color color = _t2color[*i]; 
-			glColor4d(color[0],color[1],color[2],.7);
-		}
-		else
-			glColor4d(.5,.5,.8,.7);; 
+	// all triangles in one call, then the outlines on top of them
+	updateFill(); 
+	_stats.count(SC_VERTS,_fill.draw(GL_TRIANGLES)); 
 
-		for(int j=0;j<(*i)->size();j++){
-			Pt2* p = (*i)->get(j); 
-			glVertex2d((*p)[0],(*p)[1]); 
+	list<Tri2*>* geom = _tentry->getGeoms(); 
+	double xs[3], ys[3]; 
+	_outlines.clear(); 
+	for(list<Tri2*>::iterator i=geom->begin();i!=geom->end();i++){
+		if(_editing.find(*i)==_editing.end()) continue; 
+		for(int j=0;j<3;j++){
+			xs[j] = (*(*i)->get(j))[0]; 
+			ys[j] = (*(*i)->get(j))[1]; 
 		}
-		glEnd(); 
-
-		if(_editing.find(*i)!=_editing.end()){
-			glLineWidth(3.f); 
-			glColor3f(0.,1.,0); 
-			glBegin(GL_LINE_LOOP); 
-			for(int j=0;j<(*i)->size();j++){
-				Pt2* p = (*i)->get(j); 
-				glVertex2d((*p)[0],(*p)[1]); 
-			}
-			glEnd(); 
-			glLineWidth(1.f); 
+		_outlines.addLoop(xs,ys,3,0xff00ff00); // green
+	}
+	int editVerts = _outlines.size(); 
+	if(_highlighted){
+		for(int j=0;j<3;j++){
+			xs[j] = (*_highlighted->get(j))[0]; 
+			ys[j] = (*_highlighted->get(j))[1]; 
 		}
+		_outlines.addLoop(xs,ys,3,0xff0000ff); // red
+	}
+	glLineWidth(3.f); 
+	_outlines.draw(GL_LINES,0,editVerts); 
+	glLineWidth(2.f); 
+	_outlines.draw(GL_LINES,editVerts); 
+	glLineWidth(1.f); 
 
-		if(*i==_highlighted){
-			glLineWidth(2.f); 
-			glColor3f(1.,0,0); 
-			glBegin(GL_LINE_LOOP); 
-			for(int j=0;j<(*i)->size();j++){
-				Pt2* p = (*i)->get(j); 
-				glVertex2d((*p)[0],(*p)[1]); 
-			}
-			glEnd(); 
-
-			glColor3d(1.,0.,0.);  
-			for(int j=0;j<(*i)->size();j++){
-				glRasterPos2d((*(*i)->get(j))[0]-(GCW[j]/2),
-					(*(*i)->get(j))[1]+(GCH/4)); 
-				string str=""; 
-				str+=(char)('a'+j); 
-				glutBitmapString(GLUT_BITMAP_HELVETICA_18, (unsigned char*) str.c_str()); 
-			}
-			glLineWidth(1.f); 
+	if(_highlighted){
+		glColor3d(1.,0.,0.);  
+		for(int j=0;j<_highlighted->size();j++){
+			glRasterPos2d((*_highlighted->get(j))[0]-(GCW[j]/2),
+				(*_highlighted->get(j))[1]+(GCH/4)); 
+			string str=""; 
+			str+=(char)('a'+j); 
+			glutBitmapString(GLUT_BITMAP_HELVETICA_18, (unsigned char*) str.c_str()); 
 		}
+	}
 
-		for(int j=0;j<(*i)->size();j++){
-			Pt2* p = (*i)->get(j); 
-			if(p==_highlightedPt){
-				glBegin(GL_POINTS); 
-				glColor3f(1,0,0); 
-				glVertex2d((*p)[0],(*p)[1]); 
-				glEnd(); 
-			}
-		}
+	map<Pt2*,Tri2*>::iterator hp = _tentry->getP2Geom()->find(_highlightedPt); 
+	if(hp!=_tentry->getP2Geom()->end() && hp->second){
+		glBegin(GL_POINTS); 
+		glColor3f(1,0,0); 
+		glVertex2d((*_highlightedPt)[0],(*_highlightedPt)[1]); 
+		glEnd(); 
 	}
 
 	if(_tentry->getTransCenter()==_highlightedPt)
@@ -223,12 +316,14 @@ void IFSViewer::draw(){
 	glVertex2d(tcenter[0]+1.5,tcenter[1]-11); 
 	glEnd(); 
 
-
+	timer.stop(); 
+	_stats.endFrame(); 
+	_stats.drawOverlay(getWidth(),getHeight()); 
 	swap_buffers(); 
 }
 
 Pt2 IFSViewer::win2Screen(int x, int y){
-	Vec2 winv(x/(double)getWidth(),(getHeight()-y)/(double)getHeight(),0); 
+	Vec2 winv(x/(double)getWidth(),(getHeight()-y)/(double)getHeight()); 
 	Vec2 diff = _dspaceUR-_dspaceLL; 
 	diff[0]*=winv[0]; 
 	diff[1]*=winv[1]; 
@@ -237,9 +332,16 @@ Pt2 IFSViewer::win2Screen(int x, int y){
 }
 
 int IFSViewer::handle(int ev){
+	// a plain mouse move only needs a redraw if the highlight changes
+	Tri2* oldHighlighted = _highlighted; 
+	Pt2* oldHighlightedPt = _highlightedPt; 
+	if(ev==FL_PUSH || ev==FL_DRAG || ev==FL_RELEASE)
+		requestRedraw(); 
+
 	// input in 2d mode
 	if(ev==FL_PUSH){
 		if(Fl::event_button()==FL_LEFT_MOUSE){
+			updatePick(); 
 			_prevpos = win2Screen(Fl::event_x(),Fl::event_y()); 
 			if(_highlighted){
 				_selected = _highlighted; 
@@ -298,15 +400,14 @@ int IFSViewer::handle(int ev){
 					}
 				}
 
-				for(map<Pt2*,Tri2*>::iterator i=_tentry->getP2Geom()->begin();i!=_tentry->getP2Geom()->end();i++){
-					if(i->second==_selected) continue; 
-					for(int j=0;j<_selected->size();j++){
-						double nd = Utils::dist2d(*_selected->get(j),*i->first); 
-						if(nd<bestd){
-							goodind = j; 
-							bestd = nd; 
-							best = i->first; 
-						}
+				// nothing further than 15 is snapped to
+				for(int j=0;j<_selected->size();j++){
+					double nd; 
+					Pt2* p = closestPt(*_selected->get(j),min(bestd,15.),_selected,NULL,nd); 
+					if(p && nd<bestd){
+						goodind = j; 
+						bestd = nd; 
+						best = p; 
 					}
 				}
 
@@ -325,6 +426,7 @@ int IFSViewer::handle(int ev){
 						(*_selected->get(j))=mpos+(*_snapvs.get(j)); 
 					_snapped = false; 
 				}
+				geomChanged(); 
 
 				_prevpos = mpos; 
 			}
@@ -333,17 +435,8 @@ int IFSViewer::handle(int ev){
 					pair<double,int> check = _transgrid->findClosest(*_selectedPt); 
 
 					bool useGrid = false; 
-					double bestd=10000; 
-					Pt2* best = NULL; 
-
-					for(map<Pt2*,Tri2*>::iterator i=_tentry->getP2Geom()->begin();i!=_tentry->getP2Geom()->end();i++){
-						if(i->first==_selectedPt) continue; 
-						double nd = Utils::dist2d(*(i->first),mpos); 
-						if(nd<bestd){
-							bestd = nd; 
-							best = i->first; 
-						}
-					}
+					double bestd; 
+					Pt2* best = closestPt(mpos,15,NULL,_selectedPt,bestd); 
 
 					if(check.first<bestd){
 						useGrid = true; 
@@ -361,12 +454,14 @@ int IFSViewer::handle(int ev){
 						(*_selectedPt) = mpos; 
 						_snapped = false; 
 					}
+					geomChanged(); 
 				}
 				else{
 					double nx = ((int)(mpos[0]/10+.5))*10; 
 					double ny = ((int)(mpos[1]/10+.5))*10; 
 					(*_selectedPt) = Pt2(nx,ny); 
 					_transgrid->setBase(_tentry->getBase()); 
+					geomChanged(); 
 				}
 
 				_prevpos = mpos; 
@@ -429,32 +524,22 @@ int IFSViewer::handle(int ev){
 		_zooming = false; 
 	}
 	else if(ev==FL_MOVE){
+		ScopedTimer timer(&_stats,ST_PICK); 
 		Pt2 mpos = win2Screen(Fl::event_x(),Fl::event_y()); 
 		double ratio = Utils::dist2d(_dspaceLL,_dspaceUR)/600;
 
 		if(!_baseEdit){
-			_highlightedPt = NULL; 
-			double bestd=10000; 
-			Pt2* best = NULL; 
-			for(map<Pt2*,Tri2*>::iterator i=_tentry->getP2Geom()->begin();i!=_tentry->getP2Geom()->end();i++){
-				double nd = Utils::dist2d(*(i->first),mpos); 
-				if(nd<bestd){
-					bestd = nd; 
-					best = i->first; 
-				}
-			}
-			if(best && bestd<5*ratio)
-				_highlightedPt = best; 
-
+			updatePick(); 
+			double bestd; 
+			_highlightedPt = closestPt(mpos,5*ratio,NULL,NULL,bestd); 
 
 			_highlighted = NULL; 
 			if(_highlightedPt==NULL){
-				for(list<Tri2*>::reverse_iterator i=_tentry->getGeoms()->rbegin();i!=_tentry->getGeoms()->rend();i++){
-					if(Utils::isPtInterior(*i,mpos)){
-						_highlighted = *i; 
-						break; 
-					}
-				}
+				long long tests = _pick.tests(); 
+				int s = _pick.shapeAt(mpos); 
+				if(s>=0)
+					_highlighted = _pickTris[s]; 
+				_stats.count(SC_HITTESTS,_pick.tests()-tests); 
 			}
 
 		}
@@ -476,8 +561,17 @@ int IFSViewer::handle(int ev){
 			if(best && bestd<5*ratio)
 				_highlightedPt = best; 
 		}
+
+		if(_highlighted!=oldHighlighted || _highlightedPt!=oldHighlightedPt)
+			requestRedraw(); 
+	}
+	else if(ev==FL_KEYDOWN || ev==FL_SHORTCUT){
+		// shortcuts reach the viewer under the mouse without the focus
+		if(_stats.handleKey(Fl::event_key(),Fl::event_state(FL_SHIFT)!=0)){
+			requestRedraw(); 
+			return 1; 
+		}
 	}
-	else if(ev==FL_KEYDOWN){}
 	else if(ev==FL_KEYUP){
 		if(Fl::event_key()==FL_Delete){
 			cout<<"deleting"<<endl;
@@ -494,6 +588,7 @@ void IFSViewer::resize(int x, int y, int width, int height){
 	_h = height; 
 
 	Fl_Gl_Window::resize(x,y,width,height);
+	requestRedraw(); 
 }
 
 
@@ -522,6 +617,7 @@ void IFSViewer::addOneTransformCb(Fl_Widget* widget,void* userdata){
 		b = min(b,1.); 
 		viewer->_t2color[nt] = Color(r,g,b); 
 		viewer->_tentry->add(nt); 
+		viewer->geomChanged(); 
 	}
 }
 
@@ -530,6 +626,7 @@ void IFSViewer::delEditingTransformsCb(Fl_Widget* widget,void* userdata){
 	if(viewer){
 		for(set<Tri2*>::iterator i=viewer->_editing.begin();i!=viewer->_editing.end();i++)
 			viewer->_tentry->remove(*i); 
+		viewer->geomChanged(); 
 	}
 }
 
@@ -540,20 +637,130 @@ void IFSViewer::applyIFSCb(Fl_Widget* widget,void* userdata){
 	GeometryViewer* ov = (GeometryViewer*) viewers->first; 
 	IFSViewer* tv = (IFSViewer*) viewers->second; 
 
-	list<pair<Geom2*,Color> >* geoms = ov->getGeomHistory()->getTop(); 
+	GeometryHistory* hist = ov->getGeomHistory(); 
 	list<Transformation*> trans = tv->getTransforms(); 
-	list<pair<Geom2*,Color> >* ngeoms = ov->getGeomHistory()->pushNew(); 
-	for(list<pair<Geom2*,Color> >::iterator i=geoms->begin();i!=geoms->end();i++){
-		for(list<Transformation*>::iterator j=trans.begin();j!=trans.end();j++){
-			Geom2* ng; 
-			i->first->accept(*j,&ng); 
-			ngeoms->push_back(make_pair(ng,i->second)); 
-		}
+	vector<Affine::Map> maps; 
+	for(list<Transformation*>::iterator j=trans.begin();j!=trans.end();j++)
+		maps.push_back(Affine::fromMat3(*(*j)->getmat())); 
+	if(maps.empty()) return; 
+	// charged to the viewer that shows the result, next to its prepareGeom
+	ScopedTimer timer(&ov->_stats,ST_APPLY); 
+
+	// a generation that still fits the undo budget next to what the
+	// history holds is expanded into a plain batch, whose shapes can be
+	// picked, dragged and deleted
+	GeometryBatch* geoms = hist->getTop(); 
+	int k = (int)maps.size(); 
+	if(hist->getTopImplicit()->empty() && geoms->size()>0 
+		&& hist->bytes()+GeometryBatch::bytes((double)geoms->size()*k,(double)geoms->numVerts()*k)<=hist->getBudget()){
+		// ordered by map first, then by source shape
+		GeometryBatch* ngeoms = new GeometryBatch(); 
+		ngeoms->addImages(*geoms,&maps[0],k,tv->_pool); 
+		double quantum = tv->_dedup ? DEDUP_QUANTUM : 0; 
+		if(quantum>0)
+			ov->_stats.count(SC_COLLAPSED,ngeoms->dedup(quantum,tv->_dedupArea)); 
+		// the maps let the history rebuild it once it is evicted
+		ov->prepareGeom(hist->pushImages(ngeoms,maps,quantum,tv->_dedupArea)); 
+		return; 
+	}
+
+	// past that nothing is expanded here: the new generation keeps the old
+	// one as seeds plus maps, and the viewer expands only what is on screen
+	vector<ImplicitIFS*> parts = *hist->getTopImplicit(); 
+	for(int j=0;j<(int)parts.size();j++){
+		parts[j] = new ImplicitIFS(*parts[j]); 
+		parts[j]->addLevel(maps); 
+	}
+	if(geoms->size()>0){
+		parts.push_back(new ImplicitIFS(*geoms)); 
+		parts.back()->addLevel(maps); 
 	}
+	for(int j=0;j<(int)parts.size();j++)
+		parts[j]->setDedup(tv->_dedup ? DEDUP_QUANTUM : 0,tv->_dedupArea); 
 
+	GeometryBatch* ngeoms = hist->pushNew(parts); 
 	ov->prepareGeom(ngeoms); 
 }
 
+void IFSViewer::chaosGameCb(Fl_Widget* widget,void* userdata){
+	pair<GeometryViewer*,IFSViewer*>* viewers = (pair<GeometryViewer*,IFSViewer*>*) userdata; 
+	GeometryViewer* ov = (GeometryViewer*) viewers->first; 
+	IFSViewer* tv = (IFSViewer*) viewers->second; 
+
+	// each map is drawn in the colour of its triangle in the IFS viewer
+	vector<Affine::Map> maps; 
+	vector<Color> colors; 
+	map<Tri2*,Transformation*>* t2t = tv->_tentry->getTri2Trans(); 
+	for(map<Tri2*,Transformation*>::iterator j=t2t->begin();j!=t2t->end();j++){
+		maps.push_back(Affine::fromMat3(*j->second->getmat())); 
+		if(tv->_t2color.find(j->first)!=tv->_t2color.end())
+			colors.push_back(tv->_t2color[j->first]); 
+		else
+			colors.push_back(Color(.5,.5,.8)); 
+	}
+	if(maps.empty()) return; 
+
+	int w,h; 
+	Pt2 ll,ur; 
+	ov->getView(w,h,ll,ur); 
+	if(!DensityHistogram::fits(w,h,true)){
+		cout<<"a "<<w<<" x "<<h<<" view is too large for a density histogram"<<endl; 
+		return; 
+	}
+	DensityHistogram* nhist = new DensityHistogram(w,h,ll,ur,true); 
+
+	// pressing again with the same IFS and view keeps adding to the density
+	DensityHistogram* hist = ov->getDensity(); 
+	if(hist && tv->_chaos && tv->_chaos->sameMaps(&maps[0],(int)maps.size()) && hist->sameGrid(*nhist)){
+		delete nhist; 
+	}
+	else{
+		delete tv->_chaos; 
+		tv->_chaos = new ChaosGame(&maps[0],(int)maps.size(),rand()+1); 
+		hist = nhist; 
+	}
+
+	tv->_chaos->setColors(&colors[0]); 
+	tv->_chaos->run(*hist,CHAOS_POINTS,tv->_pool); 
+	ov->setDensity(hist); 
+}
+
+void IFSViewer::toggleDedupCb(Fl_Widget* widget,void* userdata){
+	pair<GeometryViewer*,IFSViewer*>* viewers = (pair<GeometryViewer*,IFSViewer*>*) userdata; 
+	GeometryViewer* ov = (GeometryViewer*) viewers->first; 
+	IFSViewer* tv = (IFSViewer*) viewers->second; 
+
+	tv->_dedup = !tv->_dedup; 
+	widget->label(tv->_dedup ? "Dedup On" : "Dedup Off"); 
+
+	// the generation on screen follows at once, older ones on their Apply
+	vector<ImplicitIFS*>* parts = ov->getGeomHistory()->getTopImplicit(); 
+	for(int j=0;j<(int)parts->size();j++)
+		(*parts)[j]->setDedup(tv->_dedup ? DEDUP_QUANTUM : 0,tv->_dedupArea); 
+	ov->requestRedraw(); 
+}
+
+void IFSViewer::togglePreviewCb(Fl_Widget* widget,void* userdata){
+	pair<GeometryViewer*,IFSViewer*>* viewers = (pair<GeometryViewer*,IFSViewer*>*) userdata; 
+	GeometryViewer* ov = (GeometryViewer*) viewers->first; 
+	IFSViewer* tv = (IFSViewer*) viewers->second; 
+
+	if(!tv->_preview){
+		tv->_previewView = ov; 
+		tv->_preview = new ChaosPreview(previewReadyCb,tv); 
+		ov->setViewListener(previewViewCb,tv); 
+		tv->updatePreview(); 
+		widget->label("Preview On"); 
+	}
+	else{
+		delete tv->_preview; 
+		tv->_preview = NULL; 
+		ov->setViewListener(NULL,NULL); 
+		ov->setDensity(NULL); 
+		widget->label("Preview Off"); 
+	}
+}
+
 void IFSViewer::saveCurrentIFSCb(Fl_Widget* widget,void* userdata){
 	IFSViewer* tv = (IFSViewer*) userdata; 
 
@@ -620,46 +827,29 @@ void IFSViewer::IFSBrowserSelectCb(Fl_Widget* widget, void* userdata){
 
 void IFSViewer::defaultViewCb(Fl_Widget*, void* userdata){
 	IFSViewer* viewer = (IFSViewer*) userdata; 
-	if(viewer)
+	if(viewer){
 		viewer->defaultView(); 
+		viewer->requestRedraw(); 
+	}
 }
 
 void IFSViewer::saveIFSsToFile(Fl_Widget*, void* userdata){
 	IFSViewer* viewer = (IFSViewer*) userdata; 
 
 	if(viewer){
-		char* newfile = fl_file_chooser("Save IFS", ".txt (*.txt)", "./files", 0);
+		char* newfile = fl_file_chooser("Save IFS", "IFS files (*.{txt,ifsb})", "./files", 0);
 		if(!newfile) {cout<<"Save IFS canceled"<<endl; return;}
 
-		fstream outf(newfile,ios::out); 
-		list<string> names = viewer->_tmanager.getEntryNames(); 
-		outf<<names.size()<<endl;  // first line is the number of IFSs
-
-		for(list<string>::iterator j=names.begin();j!=names.end();j++){
-			outf<<*j<<endl; // output the name of this IFS
-			TransformEntry* ent = viewer->_tmanager.getEntry(*j); 
-
-			// output the base triangle on the next line
-			Tri2* tri = ent->getBase(); 
-			for(int k=0;k<tri->size();k++){
-				Pt2* p = tri->get(k); 
-				outf<<(*p)[0]<<" "<<(*p)[1]<<" "; 
-			}
-			cout<<endl;
-
-			list<Tri2*>* tris = ent->getGeoms(); 
-			outf<<tris->size()<<endl; // output the number of transformations in this IFS
-
-			// output the triangles in the IFS
-			for(list<Tri2*>::iterator i=tris->begin();i!=tris->end();i++){
-				Tri2* tri = *i; 
-				for(int k=0;k<tri->size();k++){
-					Pt2* p = tri->get(k); 
-					outf<<(*p)[0]<<" "<<(*p)[1]<<" "; 
-				}
-				outf<<endl;
-			}
+		// .ifsb gets the binary format, anything else the text one
+		string name(newfile); 
+		if(name.size()>5 && name.substr(name.size()-5)==".ifsb"){
+			if(!SceneFile::write(newfile,&viewer->_tmanager,NULL))
+				cout<<"could not write "<<name<<endl; 
+			return; 
 		}
+
+		fstream outf(newfile,ios::out); 
+		viewer->_tmanager.write(outf); 
 		outf.close(); 
 	}
 }
@@ -668,48 +858,26 @@ void IFSViewer::openIFSsToFile(Fl_Widget*, void* userdata){
 	IFSViewer* viewer = (IFSViewer*) userdata; 
 
 	if(viewer){
-		char* newfile = fl_file_chooser("Open IFS", ".txt (*.txt)", "./files", 0);
+		char* newfile = fl_file_chooser("Open IFS", "IFS files (*.{txt,ifsb})", "./files", 0);
 		if(!newfile) {cout<<"Open IFS canceled"<<endl; return;}
 
-		fstream inf(newfile,ios::in); 
-		int nifs = 0; 
-		inf>>nifs; 
+		list<string> names; 
+		if(SceneFile::isScene(newfile)){
+			SceneFile scene; 
+			if(scene.open(newfile))
+				names = scene.readIFS(viewer->_tmanager); 
+		}
+		else{
+			fstream inf(newfile,ios::in); 
+			names = viewer->_tmanager.read(inf); 
+		}
 
-		if(nifs<1) return; 
+		if(names.empty()) return; 
 
-		viewer->_tmanager.removeAllEntry(); 
 		viewer->_tbrowser->clear(); 
+		for(list<string>::iterator j=names.begin();j!=names.end();j++)
+			viewer->_tbrowser->add(j->c_str()); 
 
-		for(int j=0;j<nifs;j++){
-			string name; 
-			inf>>name; 
-
-			TransformEntry* ent = viewer->_tmanager.newEntry(name); 
-
-			Tri2* tri = ent->getBase(); 
-			for(int i=0;i<3;i++){
-				Pt2* p= tri->get(i); 
-				double d0,d1; 
-				inf>>d0>>d1;
-				(*p) = Pt2(d0,d1); 
-			}
-
-			int ntris; 
-			inf>>ntris; 
-			for(int k=0;k<ntris;k++){
-				Tri2* tri = new Tri2(); 
-				for(int i=0;i<3;i++){
-					Pt2* p= tri->get(i); 
-					double d0,d1; 
-					inf>>d0>>d1;
-					(*p) = Pt2(d0,d1); 
-				}
-
-				ent->add(tri); 
-			}
-
-			viewer->_tbrowser->add(name.c_str()); 
-		}
 		viewer->_editing.clear(); 
 
 		viewer->_tbrowser->value(1); 
@@ -13,6 +13,13 @@
 #include "Rendering/IFSViewer.h"
 #include "Rendering/Manager.h"
 #include "Rendering/TransformGroup.h"
+#include "Common/WorkerPool.h"
+#include "Rendering/ChaosGame.h"
+#include "Rendering/ChaosPreview.h"
+#include "Rendering/PickGrid.h"
+#include "Rendering/VertexBatch.h"
+#include "GUI/RedrawScheduler.h"
+#include "GUI/FrameStats.h"
 
 #include <list>
 #include <map>
@@ -22,7 +29,9 @@
 using namespace std;
 using namespace TinyGeom;
 
-#define REFRESH_RATE .001
+class GeometryViewer;
+
+#define CHAOS_POINTS 5000000 // points added per press of the chaos button
 
 class IFSViewer : public Fl_Gl_Window{
 protected:
@@ -57,6 +66,36 @@ protected:
 
 	bool _baseEdit;
 
+	RedrawScheduler _redraw;
+	FrameStats _stats; // overlay toggled with p
+
+	// picking goes through a flat copy of the entry's triangles, rebuilt
+	// on the next use after geomChanged()
+	GeometryBatch _pickGeom; 
+	vector<Tri2*> _pickTris; 
+	map<Tri2*,int> _pickIndex; 
+	PickGrid _pick; 
+	bool _pickDirty; 
+
+	// the triangles packed for a single draw call, likewise rebuilt on the
+	// next draw after geomChanged(); the outlines are packed every frame
+	VertexBatch _fill; 
+	bool _fillDirty; 
+	VertexBatch _outlines; 
+
+	WorkerPool* _pool; // runs Apply's expansion and the chaos game
+	ChaosGame* _chaos; // orbit behind the GeometryViewer's density, if any
+
+	// live attractor of the entry being edited, shown in _previewView;
+	// NULL while the preview is off
+	ChaosPreview* _preview; 
+	GeometryViewer* _previewView; 
+
+	// whether Apply collapses coinciding and degenerate shapes of its
+	// generations, see ImplicitIFS
+	bool _dedup; 
+	double _dedupArea; 
+
 	inline int getWidth() { return _w; }
 	inline int getHeight() { return _h; }
 
@@ -74,6 +113,23 @@ protected:
 
 	void setAsEntry(TransformEntry* ent);
 
+	void updatePick(); 
+	void updateFill(); 
+	// index of p in _pickGeom, -1 for points that are not triangle corners
+	int pickVertex(Pt2* p); 
+	int pickShape(Tri2* t){
+		map<Tri2*,int>::iterator i = _pickIndex.find(t); 
+		return i==_pickIndex.end() ? -1 : i->second; 
+	}
+	// closest triangle corner or transformation center to p within radius
+	Pt2* closestPt(const Pt2& p, double radius, Tri2* skipTri, Pt2* skipPt, double& dist); 
+
+	// maps of the triangles as they are on screen, also halfway through a
+	// drag, and the colour of each
+	void currentMaps(vector<Affine::Map>& maps, vector<Color>& colors); 
+	void updatePreview(); 
+	static void previewReadyCb(void* userdata); 
+
 public:
 	IFSViewer(int x, int y, int w, int h, const char* l=0);
 	~IFSViewer();
@@ -81,16 +137,16 @@ public:
 	int handle(int flag);
 	void init();
 
-	static void updateCb(void* userdata){
-		IFSViewer* viewer = (IFSViewer*) userdata;
-		viewer->redraw();
-		Fl::repeat_timeout(REFRESH_RATE,IFSViewer::updateCb,userdata);
-	}
+	// everything that changes what is on screen calls this instead of redraw()
+	void requestRedraw() { _redraw.request(); }
+	void setMaxFps(double fps) { _redraw.setMaxFps(fps); }
 
 	void setBaseGrid(BaseGrid* tg) {
 		_transgrid = tg;
+		_transgrid->addListener(gridChangedCb,this);
 		_transgrid->setBase(_tentry->getBase());
 	}
+	static void gridChangedCb(void* userdata) { ((IFSViewer*) userdata)->requestRedraw(); }
 
 	void setTransformBrowser(TransformBrowser* tb) {
 		_tbrowser = tb;
@@ -116,6 +172,27 @@ public:
 	void resize(int x, int y, int width, int height);
 	void set2DProjection();
 
+	// call after moving, adding or removing triangles of the current entry
+	void geomChanged() { _pickDirty = true; _fillDirty = true; updatePreview(); requestRedraw(); }
+
+	// number of threads used to generate a new IFS generation, the
+	// calling thread included; defaults to WorkerPool::defaultThreads()
+	void setThreadCount(int n){
+		if(n<1) n = 1;
+		if(_pool && _pool->size()==n) return;
+		delete _pool;
+		_pool = new WorkerPool(n);
+	}
+	int getThreadCount() const { return _pool->size(); }
+
+	// shapes under minArea are dropped while dedup is on; takes effect
+	// from the next Apply or toggle
+	void setDedup(bool on, double minArea=DEDUP_MIN_AREA){
+		_dedup = on; 
+		_dedupArea = minArea; 
+	}
+	bool getDedup() const { return _dedup; }
+
 	list<Transformation*> getTransforms() const {
 		list<Transformation*> ret;
 		for(map<Tri2*,Transformation*>::const_iterator i=_tentry->getTri2Trans()->begin();
@@ -137,6 +214,11 @@ public:
 	static void addOneTransformCb(Fl_Widget* widget,void* userdata);
 	static void delEditingTransformsCb(Fl_Widget* widget,void* userdata);
 	static void applyIFSCb(Fl_Widget* widget,void* userdata);
+	static void chaosGameCb(Fl_Widget* widget,void* userdata);
+	static void togglePreviewCb(Fl_Widget* widget,void* userdata);
+	// the preview's window follows the GeometryViewer's
+	static void previewViewCb(void* userdata) { ((IFSViewer*) userdata)->updatePreview(); }
+	static void toggleDedupCb(Fl_Widget* widget,void* userdata);
 	static void saveCurrentIFSCb(Fl_Widget* widget,void* userdata);
 	static void delCurrentIFSCb(Fl_Widget* widget,void* userdata);
 	static void IFSBrowserSelectCb(Fl_Widget* widget, void* userdata);
@@ -153,6 +235,7 @@ public:
 				w->label("Base On");
 			else
 				w->label("Base Off");
+			viewer->requestRedraw();
 		}
 	}
 
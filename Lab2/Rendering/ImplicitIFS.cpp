@@ -0,0 +1,186 @@
+#include "Rendering/ImplicitIFS.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+// box around m applied to the four corners of b
+static void mapBox(const Affine::Map& m, const double* b, double* out){
+	out[0] = out[1] = 1e300; 
+	out[2] = out[3] = -1e300; 
+	for(int j=0;j<4;j++){
+		Pt2 p = Affine::apply(m,Pt2(b[(j&1)?2:0],b[(j&2)?3:1])); 
+		out[0] = min(out[0],p[0]); 
+		out[1] = min(out[1],p[1]); 
+		out[2] = max(out[2],p[0]); 
+		out[3] = max(out[3],p[1]); 
+	}
+}
+
+// a node's map, as the rounded images of three corners of its level's box
+struct NodeKey{
+	long long q[6]; 
+	bool operator==(const NodeKey& o) const { return equal(q,q+6,o.q); }
+}; 
+
+struct NodeKeyHash{
+	size_t operator()(const NodeKey& k) const {
+		size_t h = 0; 
+		for(int j=0;j<6;j++)
+			h = h*1000003u^hash<long long>()(k.q[j]); 
+		return h; 
+	}
+}; 
+
+static NodeKey nodeKey(const Affine::Map& m, const double* b, double quantum){
+	// three corners fix an affine map; on a flat box they still fix it
+	// on the line the shapes lie on
+	Pt2 c[3] = {Pt2(b[0],b[1]),Pt2(b[2],b[1]),Pt2(b[0],b[3])}; 
+	NodeKey k; 
+	for(int j=0;j<3;j++){
+		Pt2 p = Affine::apply(m,c[j]); 
+		k.q[2*j] = llround(p[0]/quantum); 
+		k.q[2*j+1] = llround(p[1]/quantum); 
+	}
+	return k; 
+}
+
+ImplicitIFS::ImplicitIFS(const GeometryBatch& seed) : _seed(seed){
+	_bounds.resize(4); 
+	_bounds[0] = _bounds[1] = 1e300; 
+	_bounds[2] = _bounds[3] = -1e300; 
+	for(int i=0;i<_seed.size();i++){
+		double b[4]; 
+		_seed.bounds(i,b); 
+		_bounds[0] = min(_bounds[0],b[0]); 
+		_bounds[1] = min(_bounds[1],b[1]); 
+		_bounds[2] = max(_bounds[2],b[2]); 
+		_bounds[3] = max(_bounds[3],b[3]); 
+	}
+
+	double rgb[3] = {0,0,0}; 
+	for(int i=0;i<_seed.size();i++){
+		unsigned int c = _seed.packedColor(i); 
+		for(int j=0;j<3;j++)
+			rgb[j] += (c>>(8*j))&0xff; 
+	}
+	int n = max(_seed.size(),1); 
+	_dotColor = 0xff000000; 
+	for(int j=0;j<3;j++)
+		_dotColor |= ((unsigned int)(rgb[j]/n+.5))<<(8*j); 
+
+	double area = 0; 
+	for(int i=0;i<_seed.size();i++)
+		area = max(area,fabs(_seed.area(i))); 
+	_maxArea.push_back(area); 
+
+	_quantum = 0; 
+	_minArea = 0; 
+}
+
+void ImplicitIFS::addLevel(const vector<Affine::Map>& maps){
+	_levels.push_back(maps); 
+
+	const double* prev = &_bounds[_bounds.size()-4]; 
+	double b[4] = {1e300,1e300,-1e300,-1e300}; 
+	for(int m=0;m<(int)maps.size();m++){
+		double mb[4]; 
+		mapBox(maps[m],prev,mb); 
+		b[0] = min(b[0],mb[0]); 
+		b[1] = min(b[1],mb[1]); 
+		b[2] = max(b[2],mb[2]); 
+		b[3] = max(b[3],mb[3]); 
+	}
+	_bounds.insert(_bounds.end(),b,b+4); 
+
+	double det = 0; 
+	for(int m=0;m<(int)maps.size();m++)
+		det = max(det,fabs(maps[m].a*maps[m].d-maps[m].b*maps[m].c)); 
+	_maxArea.push_back(_maxArea.back()*det); 
+}
+
+void ImplicitIFS::dropLevel(){
+	if(_levels.empty()) return; 
+	_levels.pop_back(); 
+	_bounds.resize(_bounds.size()-4); 
+	_maxArea.pop_back(); 
+}
+
+size_t ImplicitIFS::bytes() const{
+	size_t ret = sizeof(*this)+_seed.bytes()-sizeof(_seed)+(_bounds.capacity()+_maxArea.capacity())*sizeof(double); 
+	for(int r=0;r<depth();r++)
+		ret += sizeof(_levels[r])+_levels[r].capacity()*sizeof(Affine::Map); 
+	return ret; 
+}
+
+double ImplicitIFS::numShapes() const{
+	double ret = _seed.size(); 
+	for(int r=0;r<depth();r++)
+		ret *= _levels[r].size(); 
+	return ret; 
+}
+
+int ImplicitIFS::expand(GeometryBatch& out, WorkerPool* pool) const{
+	vector<Affine::Map> leaves; 
+	vector<Dot> dots; 
+	int collapsed = traverse(Pt2(-1e300,-1e300),Pt2(1e300,1e300),0,0x7fffffff,leaves,dots); 
+	if(!leaves.empty())
+		out.addImages(_seed,&leaves[0],(int)leaves.size(),pool); 
+	return collapsed; 
+}
+
+int ImplicitIFS::traverse(const Pt2& ll, const Pt2& ur, double pixel, int budget,
+	vector<Affine::Map>& leaves, vector<Dot>& dots) const {
+	// depth first from the root (identity, all levels left); children are
+	// visited in the order addImages would have stored them, so leaves
+	// come out in generation order
+	struct Node{
+		Affine::Map M; 
+		int r; 
+	}; 
+	Affine::Map id = {1,0,0,1,0,0}; 
+	Node root = {id,depth()}; 
+	vector<Node> stack(1,root); 
+
+	// maps already walked, per level
+	vector<unordered_set<NodeKey,NodeKeyHash> > seen(dedup() ? depth()+1 : 0); 
+	int collapsed = 0; 
+
+	int visited = 0; 
+	while(!stack.empty()){
+		Node n = stack.back(); 
+		stack.pop_back(); 
+
+		double b[4]; 
+		mapBox(n.M,&_bounds[4*n.r],b); 
+		if(b[2]<ll[0] || b[0]>ur[0] || b[3]<ll[1] || b[1]>ur[1])
+			continue; 
+
+		if(dedup()){
+			double det = fabs(n.M.a*n.M.d-n.M.b*n.M.c); 
+			if(det*_maxArea[n.r]<_minArea || !seen[n.r].insert(nodeKey(n.M,&_bounds[4*n.r],_quantum)).second){
+				collapsed++; 
+				continue; 
+			}
+		}
+
+		if(n.r==0){
+			leaves.push_back(n.M); 
+			continue; 
+		}
+
+		if(max(b[2]-b[0],b[3]-b[1])<pixel || ++visited>budget){
+			Dot d; 
+			d.p = Pt2((b[0]+b[2])*.5,(b[1]+b[3])*.5); 
+			d.color = _dotColor; 
+			dots.push_back(d); 
+			continue; 
+		}
+
+		const vector<Affine::Map>& maps = _levels[n.r-1]; 
+		for(int m=(int)maps.size()-1;m>=0;m--){
+			Node c = {Affine::compose(n.M,maps[m]),n.r-1}; 
+			stack.push_back(c); 
+		}
+	}
+	return collapsed; 
+}
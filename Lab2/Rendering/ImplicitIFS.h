@@ -0,0 +1,83 @@
+#ifndef IMPLICIT_IFS_H
+#define IMPLICIT_IFS_H
+
+// A generation kept as the recipe instead of the result: seed shapes and
+// the list of maps applied at each level.  Expanded, level r replaces
+// every shape s by m(s) for each map m of that level, so depth d would
+// hold seed.size() * k^d shapes.  traverse() walks that tree for one view
+// and only expands subtrees that are on screen and bigger than a pixel,
+// so memory and drawing time follow what is visible, not the depth.
+//
+// With dedup on, traverse() also collapses subtrees that coincide: two
+// nodes of the same level whose maps send the corners of that level's
+// bounds to the same points, rounded to the quantum, expand to the same
+// shapes, so only the first is walked.  Overlapping or repeated maps then
+// stop multiplying the tree.  Subtrees whose shapes are all smaller than
+// the minimum area are dropped as well.
+
+#include "Common/AffineKernel.h"
+#include "Rendering/GeometryBatch.h"
+#include <vector>
+
+using namespace std;
+
+#define IMPLICIT_NODE_BUDGET 1000000 // tree nodes visited per traverse()
+#define DEDUP_QUANTUM 1e-6 // drawing space units
+#define DEDUP_MIN_AREA 1e-6 // square drawing space units
+
+class ImplicitIFS{
+public:
+	// stands in for a subtree smaller than a pixel
+	struct Dot{
+		Pt2 p;
+		unsigned int color;
+	};
+
+protected:
+	GeometryBatch _seed;
+	vector<vector<Affine::Map> > _levels; // _levels[0] is applied first
+	// _bounds[r]: box (minx,miny,maxx,maxy) around the seed expanded by the
+	// first r levels
+	vector<double> _bounds;
+	// _maxArea[r]: bound on the area of any shape of the seed expanded by
+	// the first r levels
+	vector<double> _maxArea;
+	unsigned int _dotColor; // average seed colour
+
+	double _quantum; // 0 while dedup is off
+	double _minArea;
+
+public:
+	explicit ImplicitIFS(const GeometryBatch& seed);
+
+	const GeometryBatch& seed() const { return _seed; }
+	int depth() const { return (int) _levels.size(); }
+
+	// applies maps to the whole generation once more
+	void addLevel(const vector<Affine::Map>& maps);
+	// undoes the last addLevel
+	void dropLevel();
+
+	size_t bytes() const;
+
+	// quantum<=0 turns dedup off
+	void setDedup(double quantum, double minArea=DEDUP_MIN_AREA){
+		_quantum = quantum; 
+		_minArea = quantum>0 ? minArea : 0; 
+	}
+	bool dedup() const { return _quantum>0; }
+
+	// number of shapes of the expanded generation
+	double numShapes() const;
+	// appends the whole expanded generation to out, in the order addImages
+	// would have produced it; returns the subtrees collapsed by dedup
+	int expand(GeometryBatch& out, WorkerPool* pool=NULL) const;
+
+	// leaves gets, in generation order, the composite map of every expanded
+	// seed copy that touches [ll,ur]; subtrees narrower than pixel, or past
+	// the node budget, become dots.  Returns the subtrees collapsed by dedup.
+	int traverse(const Pt2& ll, const Pt2& ur, double pixel, int budget,
+		vector<Affine::Map>& leaves, vector<Dot>& dots) const;
+};
+
+#endif
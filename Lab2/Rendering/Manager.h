@@ -5,38 +5,192 @@
 
 #include "Common/TinyGeom.h" 
 #include "Rendering/Transformation.h" 
+#include "Rendering/GeometryBatch.h" 
+#include "Rendering/ImplicitIFS.h" 
 #include <list> 
 #include <map> 
 #include <set> 
 #include <string> 
+#include <vector> 
+#include <iostream> 
 
 using namespace std; 
 
+#define HISTORY_BUDGET ((size_t)256<<20) // bytes kept for undo by default
+
+// a generation is the editable batch plus the parts kept implicit.  Apply
+// makes the next one either explicitly, as the images of the batch below
+// under the IFS maps, or implicitly: then the batch below becomes a new
+// ImplicitIFS and the parts it already had gain a level.
+// 
+// Past the byte budget the oldest generations are evicted down to an
+// empty record, and popTop() rebuilds the new top when it gets there: from
+// the generation it pops by dropping the last level again if that one was
+// made implicitly, or else from the generation below plus the maps of the
+// explicit Apply that made it.  A generation neither can rebuild, such as
+// an opened scene or a batch edited in place, stays resident until an
+// implicit Apply lands on it.
 class GeometryHistory{
 protected: 
-	list<list<pair<Geom2*,Color> >*> _stack; 
+	struct Generation{
+		GeometryBatch* batch; // NULL while evicted
+		vector<ImplicitIFS*> parts; 
+		// the explicit Apply that made batch from the batch of the
+		// generation below, deduplicated with quantum unless it is 0; no
+		// maps when the batch came from anywhere else
+		vector<Affine::Map> maps; 
+		double quantum, minArea; 
+	}; 
+	list<Generation> _stack; 
+	size_t _budget; 
+
+	static void release(Generation& g){
+		delete g.batch; 
+		g.batch = NULL; 
+		for(int j=0;j<(int)g.parts.size();j++)
+			delete g.parts[j]; 
+		g.parts.clear(); 
+	}
+
+	static bool rebuildable(const Generation& g, const Generation& next){
+		return !g.maps.empty() || !next.parts.empty(); 
+	}
+
+	// g as it was before the implicit Apply that made next
+	static void restore(Generation& g, const Generation& next){
+		g.batch = new GeometryBatch(); 
+		for(int j=0;j<(int)next.parts.size();j++){
+			ImplicitIFS* part = new ImplicitIFS(*next.parts[j]); 
+			part->dropLevel(); 
+			if(part->depth()>0){
+				g.parts.push_back(part); 
+			}
+			else{
+				// the batch that was on top when Apply was pressed
+				*g.batch = part->seed(); 
+				delete part; 
+			}
+		}
+	}
+
+	// a new copy of the batch of g, which has maps, from the generation
+	// below.  The one above an explicit generation has no parts, so if
+	// that one is evicted too it has maps of its own.
+	static GeometryBatch* rebuild(list<Generation>::const_iterator g){
+		list<Generation>::const_iterator parent = g; 
+		parent--; 
+		GeometryBatch* tmp = parent->batch ? NULL : rebuild(parent); 
+		GeometryBatch* ret = new GeometryBatch(); 
+		ret->addImages(tmp ? *tmp : *parent->batch,&g->maps[0],(int)g->maps.size()); 
+		if(g->quantum>0)
+			ret->dedup(g->quantum,g->minArea); 
+		delete tmp; 
+		return ret; 
+	}
+
+	GeometryBatch* append(const Generation& g){
+		_stack.push_back(g); 
+		trim(); 
+		return g.batch; 
+	}
+
+	// evicts from the bottom until the resident generations fit; the top
+	// always stays, and so does anything that could not be rebuilt
+	void trim(){
+		size_t total = bytes(); 
+		list<Generation>::iterator last = --_stack.end(); 
+		for(list<Generation>::iterator i=_stack.begin();i!=last && total>_budget;i++){
+			list<Generation>::iterator next = i; 
+			next++; 
+			if(!i->batch || !rebuildable(*i,*next)) continue; 
+			total -= bytes(i->batch,i->parts); 
+			release(*i); 
+		}
+	}
+
 public: 
-	list<pair<Geom2*,Color> >* pushNew(){
-		list<pair<Geom2*,Color> >* lg = new list<pair<Geom2*,Color> >(); 
-		_stack.push_back(lg); 
-		return lg; 
+	GeometryHistory() { _budget = HISTORY_BUDGET; }
+	~GeometryHistory(){
+		// released directly, popTop() would rebuild what is evicted
+		for(list<Generation>::iterator i=_stack.begin();i!=_stack.end();i++)
+			release(*i); 
 	}
 
-	list<pair<Geom2*,Color> >* getTop(){
+	// takes ownership of parts
+	GeometryBatch* pushNew(const vector<ImplicitIFS*>& parts = vector<ImplicitIFS*>()){
+		return push(new GeometryBatch(),parts); 
+	}
+	// takes ownership of batch and parts
+	GeometryBatch* push(GeometryBatch* batch, const vector<ImplicitIFS*>& parts = vector<ImplicitIFS*>()){
+		Generation g; 
+		g.batch = batch; 
+		g.parts = parts; 
+		g.quantum = g.minArea = 0; 
+		return append(g); 
+	}
+	// takes ownership of batch, the images of the top batch under maps,
+	// then deduplicated with quantum and minArea unless quantum is 0
+	GeometryBatch* pushImages(GeometryBatch* batch, const vector<Affine::Map>& maps, 
+		double quantum=0, double minArea=0){
+		Generation g; 
+		g.batch = batch; 
+		g.maps = maps; 
+		g.quantum = quantum; 
+		g.minArea = minArea; 
+		return append(g); 
+	}
+
+	// the top batch was changed in place, so its maps no longer make it
+	void topChanged(){
 		if(_stack.size()>0)
-			return _stack.back(); 
+			_stack.back().maps.clear(); 
+	}
+
+	GeometryBatch* getTop(){
+		if(_stack.size()>0)
+			return _stack.back().batch; 
+		return NULL; 
+	}
+
+	// owned by the history, drawn below the top batch
+	vector<ImplicitIFS*>* getTopImplicit(){
+		if(_stack.size()>0)
+			return &_stack.back().parts; 
 		return NULL; 
 	}
 
 	void popTop(){
-		list<pair<Geom2*,Color> >* lg = _stack.back(); 
-		for(list<pair<Geom2*,Color> >::iterator i=lg->begin();i!=lg->end();i++)
-			delete i->first; 
-		delete lg; 
+		Generation top = _stack.back(); 
 		_stack.pop_back(); 
+		if(!_stack.empty() && !_stack.back().batch){
+			if(!top.parts.empty())
+				restore(_stack.back(),top); 
+			else
+				_stack.back().batch = rebuild(--_stack.end()); 
+		}
+		release(top); 
 	}
 
 	int size() { return (int) _stack.size();  }
+
+	void setBudget(size_t bytes) { _budget = bytes; trim(); }
+	size_t getBudget() const { return _budget; }
+
+	// memory held by the generations that are not evicted
+	size_t bytes() const {
+		size_t ret = 0; 
+		for(list<Generation>::const_iterator i=_stack.begin();i!=_stack.end();i++)
+			if(i->batch)
+				ret += bytes(i->batch,i->parts); 
+		return ret; 
+	}
+
+	static size_t bytes(const GeometryBatch* batch, const vector<ImplicitIFS*>& parts){
+		size_t ret = batch ? batch->bytes() : 0; 
+		for(int j=0;j<(int)parts.size();j++)
+			ret += parts[j]->bytes(); 
+		return ret; 
+	}
 }; 
 
 class TransformEntry{
@@ -46,6 +200,20 @@ protected:
 	map<Pt2*,Tri2*> _p2geom; 
 	map<Tri2*,Transformation*> _tri2trans; 
 	Pt2 _transCenter; // center of transformation in IFS Viewer
+	// _composites[d]: all products of d maps, see getComposites; built from
+	// _compositeMaps
+	vector<vector<Affine::Map> > _composites; 
+	vector<Affine::Map> _compositeMaps; 
+
+	static bool sameMaps(const vector<Affine::Map>& a, const vector<Affine::Map>& b){
+		if(a.size()!=b.size()) return false; 
+		for(int j=0;j<(int)a.size();j++){
+			if(a[j].a!=b[j].a || a[j].b!=b[j].b || a[j].c!=b[j].c || a[j].d!=b[j].d 
+				|| a[j].e!=b[j].e || a[j].f!=b[j].f)
+				return false; 
+		}
+		return true; 
+	}
 public: 
 	TransformEntry(){
 		_transCenter = Pt2(0,0); 
@@ -76,6 +244,47 @@ public:
 	Tri2* getBase() { return &_base; }
 	Pt2* getTransCenter() { return &_transCenter; }
 
+	// the maps in the order of getGeoms()
+	vector<Affine::Map> getMaps(){
+		vector<Affine::Map> ret; 
+		for(list<Tri2*>::iterator i=_geoms.begin();i!=_geoms.end();i++)
+			ret.push_back(Affine::fromMat3(*_tri2trans[*i]->getmat())); 
+		return ret; 
+	}
+
+	// the K^d products maps[i_d]*...*maps[i_1], ordered like the shapes of d
+	// GeometryBatch::addImages steps (the map applied last varies slowest),
+	// so one addImages with them takes the base straight to depth d.  Built
+	// breadth first from depth d-1 and kept while the maps stay the same,
+	// for offline rendering (ifsrender, ifsbench); the viewers apply one
+	// level at a time and never need them.
+	const vector<Affine::Map>& getComposites(int d){
+		vector<Affine::Map> maps = getMaps(); 
+		if(!sameMaps(maps,_compositeMaps)){
+			_composites.clear(); 
+			_compositeMaps = maps; 
+		}
+		if(_composites.empty()){
+			Affine::Map id = {1,0,0,1,0,0}; 
+			_composites.push_back(vector<Affine::Map>(1,id)); 
+		}
+		if((int)_composites.size()<=d){
+			while((int)_composites.size()<=d){
+				vector<Affine::Map> next; 
+				next.reserve(maps.size()*_composites.back().size()); 
+				for(int m=0;m<(int)maps.size();m++){
+					const vector<Affine::Map>& prev = _composites.back(); 
+					for(int p=0;p<(int)prev.size();p++)
+						next.push_back(Affine::compose(maps[m],prev[p])); 
+				}
+				_composites.push_back(next); 
+			}
+		}
+		return _composites[d]; 
+	}
+	// frees the cached composites
+	void dropComposites() { _composites.clear(); }
+
 	void remove(Tri2* t){
 		list<Tri2*> ngeoms; 
 		map<Pt2*,Tri2*> np2geom; 
@@ -194,6 +403,88 @@ public:
 			ret.push_back(i->first); 
 		return ret; 
 	}
+
+	// text format: the number of IFSs, then for each IFS its name, the base 
+	// triangle, the number of transformations and one triangle per line
+	void write(ostream& outf){
+		list<string> names = getEntryNames(); 
+		outf<<names.size()<<endl;  // first line is the number of IFSs
+
+		for(list<string>::iterator j=names.begin();j!=names.end();j++){
+			outf<<*j<<endl; // output the name of this IFS
+			TransformEntry* ent = getEntry(*j); 
+
+			// output the base triangle on the next line
+			Tri2* tri = ent->getBase(); 
+			for(int k=0;k<tri->size();k++){
+				Pt2* p = tri->get(k); 
+				outf<<(*p)[0]<<" "<<(*p)[1]<<" "; 
+			}
+			outf<<endl;
+
+			list<Tri2*>* tris = ent->getGeoms(); 
+			outf<<tris->size()<<endl; // output the number of transformations in this IFS
+
+			// output the triangles in the IFS
+			for(list<Tri2*>::iterator i=tris->begin();i!=tris->end();i++){
+				Tri2* tri = *i; 
+				for(int k=0;k<tri->size();k++){
+					Pt2* p = tri->get(k); 
+					outf<<(*p)[0]<<" "<<(*p)[1]<<" "; 
+				}
+				outf<<endl;
+			}
+		}
+	}
+
+	// replaces all entries with the ones in the stream, returns their names 
+	// in file order; nothing is touched if the stream holds no IFS
+	list<string> read(istream& inf){
+		list<string> ret; 
+		int nifs = 0; 
+		inf>>nifs; 
+
+		if(nifs<1) return ret; 
+
+		removeAllEntry(); 
+
+		for(int j=0;j<nifs;j++){
+			string name; 
+			inf>>name; 
+
+			TransformEntry* ent = newEntry(name); 
+			if(!ent){
+				// repeated name, the later definition wins
+				ent = getEntry(name); 
+				ent->clear(); 
+			}
+
+			Tri2* tri = ent->getBase(); 
+			for(int i=0;i<3;i++){
+				Pt2* p= tri->get(i); 
+				double d0,d1; 
+				inf>>d0>>d1;
+				(*p) = Pt2(d0,d1); 
+			}
+
+			int ntris = 0; 
+			inf>>ntris; 
+			for(int k=0;k<ntris;k++){
+				Tri2* tri = new Tri2(); 
+				for(int i=0;i<3;i++){
+					Pt2* p= tri->get(i); 
+					double d0,d1; 
+					inf>>d0>>d1;
+					(*p) = Pt2(d0,d1); 
+				}
+
+				ent->add(tri); 
+			}
+
+			ret.push_back(name); 
+		}
+		return ret; 
+	}
 }; 
 
 /**/
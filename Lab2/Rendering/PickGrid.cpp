@@ -0,0 +1,172 @@
+#include "Rendering/PickGrid.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+PickGrid::PickGrid(){
+	_gb = NULL;
+	_cell = 1;
+	_nx = _ny = 0;
+	_tests = 0;
+}
+
+int PickGrid::cellX(double x) const{
+	double c = floor((x-_ll[0])/_cell);
+	return (int)min((double)_nx-1,max(0.,c));
+}
+
+int PickGrid::cellY(double y) const{
+	double c = floor((y-_ll[1])/_cell);
+	return (int)min((double)_ny-1,max(0.,c));
+}
+
+void PickGrid::build(const GeometryBatch* gb){
+	_gb = gb;
+	_moved.clear();
+	_isMoved.assign(gb ? gb->size() : 0,0);
+	_shapes.clear();
+	_verts.clear();
+	_vertShape.clear();
+	_nx = _ny = 0;
+	if(!gb || gb->size()==0) return;
+
+	int ns = gb->size();
+	const double* xs = gb->xs();
+	const double* ys = gb->ys();
+
+	vector<double> bb(4*ns); // minx miny maxx maxy per shape
+	Pt2 ll(1e300,1e300), ur(-1e300,-1e300);
+	double extent = 0;
+	for(int i=0;i<ns;i++){
+		double* b = &bb[4*i];
+		gb->bounds(i,b);
+		ll = Pt2(min(ll[0],b[0]),min(ll[1],b[1]));
+		ur = Pt2(max(ur[0],b[2]),max(ur[1],b[3]));
+		extent += max(b[2]-b[0],b[3]-b[1]);
+	}
+
+	// about one shape per cell, but no smaller than the average shape so
+	// a shape rarely covers more than a few cells
+	double w = max(ur[0]-ll[0],1e-9);
+	double h = max(ur[1]-ll[1],1e-9);
+	_cell = max(sqrt(w*h/ns),extent/ns);
+	_cell = max(_cell,max(w,h)/1024);
+	_ll = ll;
+	_nx = (int)(w/_cell)+1;
+	_ny = (int)(h/_cell)+1;
+	int nc = _nx*_ny;
+
+	// counting sort into the cells, shapes and vertices stay in index order
+	_shapeStart.assign(nc+1,0);
+	_vertStart.assign(nc+1,0);
+	for(int pass=0;pass<2;pass++){
+		vector<int> fillS, fillV;
+		if(pass==1){
+			for(int c=0;c<nc;c++){
+				_shapeStart[c+1] += _shapeStart[c];
+				_vertStart[c+1] += _vertStart[c];
+			}
+			_shapes.resize(_shapeStart[nc]);
+			_verts.resize(_vertStart[nc]);
+			_vertShape.resize(_vertStart[nc]);
+			fillS.assign(_shapeStart.begin(),_shapeStart.end()-1);
+			fillV.assign(_vertStart.begin(),_vertStart.end()-1);
+		}
+		for(int i=0;i<ns;i++){
+			const double* b = &bb[4*i];
+			int x0 = cellX(b[0]), x1 = cellX(b[2]);
+			int y0 = cellY(b[1]), y1 = cellY(b[3]);
+			for(int cy=y0;cy<=y1;cy++){
+				for(int cx=x0;cx<=x1;cx++){
+					int c = cy*_nx+cx;
+					if(pass==0) _shapeStart[c+1]++;
+					else _shapes[fillS[c]++] = i;
+				}
+			}
+			for(int v=gb->offset(i);v<gb->offset(i)+gb->count(i);v++){
+				int c = cellY(ys[v])*_nx+cellX(xs[v]);
+				if(pass==0) _vertStart[c+1]++;
+				else{
+					_verts[fillV[c]] = v;
+					_vertShape[fillV[c]++] = i;
+				}
+			}
+		}
+	}
+}
+
+void PickGrid::moved(int i){
+	if(i<0 || i>=(int)_isMoved.size() || _isMoved[i]) return;
+	_isMoved[i] = 1;
+	_moved.push_back(i);
+}
+
+int PickGrid::shapeAt(const Pt2& p) const{
+	int best = -1;
+	for(unsigned int j=0;j<_moved.size();j++){
+		if(_moved[j]<=best) continue;
+		_tests++;
+		if(_gb->isPtInterior(_moved[j],p))
+			best = _moved[j];
+	}
+	if(_nx==0) return best;
+
+	double fx = (p[0]-_ll[0])/_cell;
+	double fy = (p[1]-_ll[1])/_cell;
+	if(!(fx>=0 && fx<_nx && fy>=0 && fy<_ny)) return best;
+
+	int c = (int)fy*_nx+(int)fx;
+	// entries are in index order, so the first hit from the back is on top
+	for(int j=_shapeStart[c+1]-1;j>=_shapeStart[c];j--){
+		int i = _shapes[j];
+		if(i<=best) break;
+		if(_isMoved[i]) continue;
+		_tests++;
+		if(_gb->isPtInterior(i,p))
+			return i;
+	}
+	return best;
+}
+
+int PickGrid::closestVertex(const Pt2& p, double radius, int skipShape, int skipVert, double* dist) const{
+	int best = -1;
+	double bestd = radius;
+
+	const double* xs = _gb ? _gb->xs() : NULL;
+	const double* ys = _gb ? _gb->ys() : NULL;
+	for(unsigned int j=0;j<_moved.size();j++){
+		int i = _moved[j];
+		if(i==skipShape) continue;
+		for(int v=_gb->offset(i);v<_gb->offset(i)+_gb->count(i);v++){
+			double d = Utils::dist2d(Pt2(xs[v],ys[v]),p);
+			if(v!=skipVert && d<bestd){
+				bestd = d;
+				best = v;
+			}
+		}
+	}
+
+	if(_nx>0){
+		int x0 = cellX(p[0]-radius), x1 = cellX(p[0]+radius);
+		int y0 = cellY(p[1]-radius), y1 = cellY(p[1]+radius);
+		for(int cy=y0;cy<=y1;cy++){
+			for(int cx=x0;cx<=x1;cx++){
+				int c = cy*_nx+cx;
+				for(int j=_vertStart[c];j<_vertStart[c+1];j++){
+					int v = _verts[j];
+					int i = _vertShape[j];
+					if(v==skipVert || i==skipShape || _isMoved[i]) continue;
+					double d = Utils::dist2d(Pt2(xs[v],ys[v]),p);
+					if(d<bestd){
+						bestd = d;
+						best = v;
+					}
+				}
+			}
+		}
+	}
+
+	if(dist) *dist = bestd;
+	return best;
+}
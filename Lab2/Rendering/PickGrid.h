@@ -0,0 +1,55 @@
+#ifndef PICK_GRID_H
+#define PICK_GRID_H
+
+// uniform grid over the shapes and vertices of a GeometryBatch for mouse
+// picking.  Every cell lists the shapes whose bounding box overlaps it and
+// the vertices inside it, so a query only looks at the shapes and vertices
+// near the mouse.  Shapes edited after build() are reported with moved();
+// queries then test them directly instead of through their stale cells.
+
+#include "Rendering/GeometryBatch.h"
+#include <vector>
+
+using namespace std;
+
+#define PICK_MAX_MOVED 64 // moved shapes tolerated before stale() asks for a rebuild
+
+class PickGrid{
+protected:
+	const GeometryBatch* _gb;
+	Pt2 _ll;
+	double _cell;
+	int _nx,_ny;
+
+	// per cell c, entries [start[c],start[c+1]) of the lists below
+	vector<int> _shapeStart, _shapes;
+	vector<int> _vertStart, _verts, _vertShape;
+
+	vector<int> _moved;
+	vector<char> _isMoved;
+
+	mutable long long _tests; // isPtInterior calls made by shapeAt
+
+	int cellX(double x) const;
+	int cellY(double y) const;
+
+public:
+	PickGrid();
+
+	void build(const GeometryBatch* gb);
+
+	// shape i no longer matches the grid
+	void moved(int i);
+	bool stale() const { return _moved.size()>PICK_MAX_MOVED; }
+
+	// topmost (highest index) shape containing p, -1 if none
+	int shapeAt(const Pt2& p) const;
+	// shapes shapeAt has hit-tested so far
+	long long tests() const { return _tests; }
+
+	// closest vertex to p not further than radius, -1 if none; vertices of
+	// skipShape and the vertex skipVert are ignored.  dist gets the distance.
+	int closestVertex(const Pt2& p, double radius, int skipShape=-1, int skipVert=-1, double* dist=NULL) const;
+};
+
+#endif
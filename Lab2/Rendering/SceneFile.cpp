@@ -0,0 +1,242 @@
+#include "Rendering/SceneFile.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char SCENE_MAGIC[4] = {'I','F','S','B'};
+
+SceneFile::SceneFile(){
+	_data = NULL;
+	_size = 0;
+#ifdef _WIN32
+	_file = INVALID_HANDLE_VALUE;
+	_mapping = NULL;
+#else
+	_fd = -1;
+#endif
+}
+
+SceneFile::~SceneFile(){
+	close();
+}
+
+bool SceneFile::open(const char* filename){
+	close();
+#ifdef _WIN32
+	_file = CreateFileA(filename,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+	if(_file==INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx((HANDLE)_file,&size) || size.QuadPart<(LONGLONG)sizeof(SceneHeader)){
+		close();
+		return false;
+	}
+	_size = (size_t) size.QuadPart;
+	_mapping = CreateFileMappingA((HANDLE)_file,NULL,PAGE_READONLY,0,0,NULL);
+	if(_mapping) _data = (const char*) MapViewOfFile((HANDLE)_mapping,FILE_MAP_READ,0,0,0);
+#else
+	_fd = ::open(filename,O_RDONLY);
+	if(_fd<0) return false;
+	struct stat st;
+	if(fstat(_fd,&st)!=0 || st.st_size<(off_t)sizeof(SceneHeader)){
+		close();
+		return false;
+	}
+	_size = (size_t) st.st_size;
+	void* p = mmap(NULL,_size,PROT_READ,MAP_PRIVATE,_fd,0);
+	if(p!=MAP_FAILED) _data = (const char*) p;
+#endif
+	if(!_data || !validate()){
+		close();
+		return false;
+	}
+	return true;
+}
+
+void SceneFile::close(){
+#ifdef _WIN32
+	if(_data) UnmapViewOfFile(_data);
+	if(_mapping) CloseHandle((HANDLE)_mapping);
+	if(_file!=INVALID_HANDLE_VALUE) CloseHandle((HANDLE)_file);
+	_mapping = NULL;
+	_file = INVALID_HANDLE_VALUE;
+#else
+	if(_data) munmap((void*)_data,_size);
+	if(_fd>=0) ::close(_fd);
+	_fd = -1;
+#endif
+	_data = NULL;
+	_size = 0;
+}
+
+bool SceneFile::validate() const{
+	const SceneHeader* h = header();
+	if(memcmp(h->magic,SCENE_MAGIC,4)!=0 || h->version!=SCENE_VERSION || h->fileSize!=_size)
+		return false;
+
+	// [off, off+n*elem) has to lie inside the file
+	struct Range{
+		static bool ok(scene_u64 off, scene_u64 n, scene_u64 elem, size_t size){
+			return off<=size && n<=(size-off)/elem;
+		}
+	};
+	if(!Range::ok(h->ifsOffset,h->nifs,sizeof(SceneIFS),_size)) return false;
+	for(int i=0;i<numIFS();i++){
+		if(!Range::ok(ifs(i)->nameOffset,ifs(i)->nameLength,1,_size)) return false;
+		if(!Range::ok(ifs(i)->trisOffset,(scene_u64)ifs(i)->ntris+1,6*sizeof(double),_size)) return false;
+	}
+
+	if(!hasGeometry()) return true;
+	if(h->nverts>SCENE_MAX_VERTS) return false;
+	if(!Range::ok(h->xsOffset,h->nverts,sizeof(double),_size)
+		|| !Range::ok(h->ysOffset,h->nverts,sizeof(double),_size)
+		|| !Range::ok(h->offsetsOffset,h->nshapes,sizeof(int),_size)
+		|| !Range::ok(h->countsOffset,h->nshapes,sizeof(int),_size)
+		|| !Range::ok(h->colorsOffset,h->nshapes,sizeof(unsigned int),_size)
+		|| !Range::ok(h->kindsOffset,h->nshapes,1,_size))
+		return false;
+	const int* off = offsets();
+	const int* cnt = counts();
+	for(int i=0;i<numShapes();i++)
+		if(off[i]<0 || cnt[i]<0 || (scene_u64)off[i]+cnt[i]>h->nverts)
+			return false;
+	return true;
+}
+
+list<string> SceneFile::readIFS(TransformManager& tm) const{
+	list<string> ret;
+	if(numIFS()<1) return ret;
+
+	tm.removeAllEntry();
+	for(int i=0;i<numIFS();i++){
+		string name = ifsName(i);
+		TransformEntry* ent = tm.newEntry(name);
+		if(!ent){
+			// repeated name, the later definition wins
+			ent = tm.getEntry(name);
+			ent->clear();
+		}
+
+		const double* t = ifsTris(i);
+		Tri2* base = ent->getBase();
+		for(int j=0;j<3;j++)
+			*base->get(j) = Pt2(t[2*j],t[2*j+1]);
+		for(int k=0;k<ifsNumTris(i);k++){
+			t += 6;
+			Tri2* tri = new Tri2();
+			for(int j=0;j<3;j++)
+				*tri->get(j) = Pt2(t[2*j],t[2*j+1]);
+			ent->add(tri);
+		}
+		ret.push_back(name);
+	}
+	return ret;
+}
+
+bool SceneFile::readGeometry(GeometryBatch& gb) const{
+	if(!hasGeometry()) return false;
+	gb.assign(numShapes(),numVerts(),xs(),ys(),offsets(),counts(),kinds(),colors());
+	return true;
+}
+
+// appends n bytes and pads the file to a multiple of 8, returns where they start
+static scene_u64 put(FILE* f, scene_u64& pos, const void* data, size_t n){
+	static const char zeros[8] = {0,0,0,0,0,0,0,0};
+	scene_u64 start = pos;
+	if(n) fwrite(data,1,n,f);
+	size_t pad = (8-n%8)%8;
+	fwrite(zeros,1,pad,f);
+	pos += n+pad;
+	return start;
+}
+
+bool SceneFile::write(const char* filename, TransformManager* tm, const GeometryBatch* geom){
+	FILE* f = fopen(filename,"wb");
+	if(!f) return false;
+
+	list<string> names;
+	if(tm) names = tm->getEntryNames();
+
+	SceneHeader h;
+	memset(&h,0,sizeof(h));
+	memcpy(h.magic,SCENE_MAGIC,4);
+	h.version = SCENE_VERSION;
+	h.nifs = (scene_u32) names.size();
+
+	// header and IFS table go first, their offsets are patched in at the end
+	scene_u64 pos = 0;
+	put(f,pos,&h,sizeof(h));
+	vector<SceneIFS> table(names.size());
+	h.ifsOffset = put(f,pos,table.empty() ? NULL : &table[0],table.size()*sizeof(SceneIFS));
+
+	int i = 0;
+	for(list<string>::iterator j=names.begin();j!=names.end();j++,i++){
+		TransformEntry* ent = tm->getEntry(*j);
+		vector<double> tris;
+		Tri2* base = ent->getBase();
+		for(int k=0;k<3;k++){
+			tris.push_back((*base->get(k))[0]);
+			tris.push_back((*base->get(k))[1]);
+		}
+		list<Tri2*>* geoms = ent->getGeoms();
+		for(list<Tri2*>::iterator t=geoms->begin();t!=geoms->end();t++){
+			for(int k=0;k<3;k++){
+				tris.push_back((*(*t)->get(k))[0]);
+				tris.push_back((*(*t)->get(k))[1]);
+			}
+		}
+		table[i].nameLength = (scene_u32) j->size();
+		table[i].ntris = (scene_u32) geoms->size();
+		table[i].nameOffset = put(f,pos,j->data(),j->size());
+		table[i].trisOffset = put(f,pos,&tris[0],tris.size()*sizeof(double));
+	}
+
+	if(geom){
+		int n = geom->size();
+		int nv = geom->numVerts();
+		vector<int> offsets(n), counts(n);
+		vector<unsigned int> colors(n);
+		vector<unsigned char> kinds(n);
+		for(int s=0;s<n;s++){
+			offsets[s] = geom->offset(s);
+			counts[s] = geom->count(s);
+			colors[s] = geom->packedColor(s);
+			kinds[s] = (unsigned char) geom->kind(s);
+		}
+		h.nshapes = (scene_u32) n;
+		h.nverts = (scene_u64) nv;
+		h.xsOffset = put(f,pos,geom->xs(),nv*sizeof(double));
+		h.ysOffset = put(f,pos,geom->ys(),nv*sizeof(double));
+		h.offsetsOffset = put(f,pos,n ? &offsets[0] : NULL,n*sizeof(int));
+		h.countsOffset = put(f,pos,n ? &counts[0] : NULL,n*sizeof(int));
+		h.colorsOffset = put(f,pos,n ? &colors[0] : NULL,n*sizeof(unsigned int));
+		h.kindsOffset = put(f,pos,n ? &kinds[0] : NULL,n);
+	}
+	h.fileSize = pos;
+
+	fseek(f,0,SEEK_SET);
+	fwrite(&h,sizeof(h),1,f);
+	if(!table.empty()){
+		fseek(f,(long)h.ifsOffset,SEEK_SET);
+		fwrite(&table[0],sizeof(SceneIFS),table.size(),f);
+	}
+	bool ok = !ferror(f);
+	return fclose(f)==0 && ok;
+}
+
+bool SceneFile::isScene(const char* filename){
+	FILE* f = fopen(filename,"rb");
+	if(!f) return false;
+	char magic[4];
+	bool ret = fread(magic,1,4,f)==4 && memcmp(magic,SCENE_MAGIC,4)==0;
+	fclose(f);
+	return ret;
+}
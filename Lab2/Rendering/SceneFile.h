@@ -0,0 +1,108 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+// Binary scene files (.ifsb): the IFSs of a TransformManager and,
+// optionally, one packed generation of shapes.  Everything is stored the
+// way it sits in memory, little endian, every array 8 byte aligned:
+//
+//   SceneHeader
+//   SceneIFS[nifs]
+//   per IFS: its name, then 1+ntris triangles of 6 doubles (base first)
+//   geometry: xs[nverts], ys[nverts], offsets[nshapes], counts[nshapes],
+//             colors[nshapes], kinds[nshapes]
+//
+// so SceneFile maps the file and hands out pointers into it; nothing is
+// parsed and loading costs about one copy of the arrays.
+
+#include "Rendering/Manager.h"
+#include "Rendering/GeometryBatch.h"
+#include <list>
+#include <string>
+
+using namespace std;
+
+#define SCENE_VERSION 1
+#define SCENE_MAX_VERTS 0x7fffffff // vertices are indexed by int
+
+#ifdef _MSC_VER
+typedef unsigned __int32 scene_u32;
+typedef unsigned __int64 scene_u64;
+#else
+#include <stdint.h>
+typedef uint32_t scene_u32;
+typedef uint64_t scene_u64;
+#endif
+
+struct SceneHeader{
+	char magic[4]; // "IFSB"
+	scene_u32 version;
+	scene_u32 nifs;
+	scene_u32 nshapes;
+	scene_u64 nverts;
+	scene_u64 fileSize;
+	scene_u64 ifsOffset;
+	// geometry arrays, 0 when the scene has no geometry
+	scene_u64 xsOffset, ysOffset, offsetsOffset, countsOffset, colorsOffset, kindsOffset;
+};
+
+struct SceneIFS{
+	scene_u64 nameOffset;
+	scene_u32 nameLength;
+	scene_u32 ntris;
+	scene_u64 trisOffset;
+};
+
+class SceneFile{
+protected:
+	const char* _data;
+	size_t _size;
+#ifdef _WIN32
+	void* _file;
+	void* _mapping;
+#else
+	int _fd;
+#endif
+
+	const SceneHeader* header() const { return (const SceneHeader*) _data; }
+	const SceneIFS* ifs(int i) const { return (const SceneIFS*) (_data+header()->ifsOffset)+i; }
+	// checks every offset against the file size
+	bool validate() const;
+
+public:
+	SceneFile();
+	~SceneFile();
+
+	// maps the file read-only; false if it is missing or not a valid scene
+	bool open(const char* filename);
+	void close();
+	bool isOpen() const { return _data!=NULL; }
+
+	int numIFS() const { return (int) header()->nifs; }
+	string ifsName(int i) const { return string(_data+ifs(i)->nameOffset,ifs(i)->nameLength); }
+	int ifsNumTris(int i) const { return (int) ifs(i)->ntris; }
+	// 6 doubles per triangle, the base triangle and then ifsNumTris(i) more
+	const double* ifsTris(int i) const { return (const double*) (_data+ifs(i)->trisOffset); }
+
+	bool hasGeometry() const { return header()->xsOffset!=0; }
+	int numShapes() const { return (int) header()->nshapes; }
+	int numVerts() const { return (int) header()->nverts; }
+	const double* xs() const { return (const double*) (_data+header()->xsOffset); }
+	const double* ys() const { return (const double*) (_data+header()->ysOffset); }
+	const int* offsets() const { return (const int*) (_data+header()->offsetsOffset); }
+	const int* counts() const { return (const int*) (_data+header()->countsOffset); }
+	const unsigned int* colors() const { return (const unsigned int*) (_data+header()->colorsOffset); }
+	const unsigned char* kinds() const { return (const unsigned char*) (_data+header()->kindsOffset); }
+
+	// same as TransformManager::read: replaces the entries of tm if the
+	// scene has any and returns their names in file order
+	list<string> readIFS(TransformManager& tm) const;
+	// replaces the shapes of gb, false if the scene has no geometry
+	bool readGeometry(GeometryBatch& gb) const;
+
+	// geom may be NULL; false if the file cannot be written
+	static bool write(const char* filename, TransformManager* tm, const GeometryBatch* geom);
+	// true if the file starts like a scene file, for telling them from .txt
+	static bool isScene(const char* filename);
+};
+
+#endif
@@ -0,0 +1,290 @@
+#include "Rendering/SoftRaster.h"
+#include <algorithm>
+#include <cmath>
+
+extern "C" {
+#include "Common/bmpfile.h"
+}
+
+using namespace std;
+
+SoftRaster::SoftRaster(int w, int h){
+	_w = w;
+	_h = h;
+	_rgba.resize(4*w*h);
+	_ll = Pt2(-w/2.,-h/2.);
+	_ur = Pt2(w/2.,h/2.);
+}
+
+void SoftRaster::clear(const Color& c){
+	unsigned char px[4];
+	for(int j=0;j<4;j++)
+		px[j] = (unsigned char)(min(1.,max(0.,c[j]))*255+.5);
+	for(int i=0;i<_w*_h;i++)
+		for(int j=0;j<4;j++)
+			_rgba[4*i+j] = px[j];
+}
+
+// pixel coordinates of the vertices and the rows they span, clamped to [r0,r1]
+static void toPixels(const SoftRaster& r, const double* xs, const double* ys, int n,
+	vector<double>& px, vector<double>& py, double& miny, double& maxy){
+	px.resize(n);
+	py.resize(n);
+	miny = 1e300;
+	maxy = -1e300;
+	double sx = r.width()/(r.ur()[0]-r.ll()[0]);
+	double sy = r.height()/(r.ur()[1]-r.ll()[1]);
+	for(int j=0;j<n;j++){
+		px[j] = (xs[j]-r.ll()[0])*sx;
+		py[j] = (r.ur()[1]-ys[j])*sy;
+		miny = min(miny,py[j]);
+		maxy = max(maxy,py[j]);
+	}
+}
+
+// x of every edge crossing the horizontal line at sy, sorted
+static void crossings(const vector<double>& px, const vector<double>& py, double sy, vector<double>& cross){
+	int n = (int)px.size();
+	cross.clear();
+	for(int j=0;j<n;j++){
+		int k = (j+1)%n;
+		double y0 = py[j], y1 = py[k];
+		if((y0<=sy && y1>sy) || (y1<=sy && y0>sy))
+			cross.push_back(px[j]+(sy-y0)/(y1-y0)*(px[k]-px[j]));
+	}
+	sort(cross.begin(),cross.end());
+}
+
+void SoftRaster::fillPolygon(const double* xs, const double* ys, int n, unsigned int color){
+	fillRows(xs,ys,n,color,0,_h-1,_scratch);
+}
+
+void SoftRaster::fillRows(const double* xs, const double* ys, int n, unsigned int color, int r0, int r1,
+	Scratch& scratch){
+	if(n<3) return;
+
+	vector<double>& px = scratch.px;
+	vector<double>& py = scratch.py;
+	vector<double>& cross = scratch.cross;
+	double miny, maxy;
+	toPixels(*this,xs,ys,n,px,py,miny,maxy);
+
+	// sample at pixel centres
+	r0 = max(r0,(int)ceil(max(-1.,miny)-.5));
+	r1 = min(r1,(int)floor(min((double)_h,maxy)-.5));
+
+	for(int r=r0;r<=r1;r++){
+		crossings(px,py,r+.5,cross);
+
+		unsigned char* row = &_rgba[4*r*_w];
+		for(unsigned int j=0;j+1<cross.size();j+=2){
+			int c0 = max(0,(int)ceil(max(-1.,cross[j])-.5));
+			int c1 = min(_w-1,(int)ceil(min((double)_w+1,cross[j+1])-.5)-1);
+			for(int c=c0;c<=c1;c++){
+				row[4*c] = color&0xff;
+				row[4*c+1] = (color>>8)&0xff;
+				row[4*c+2] = (color>>16)&0xff;
+				row[4*c+3] = (color>>24)&0xff;
+			}
+		}
+	}
+}
+
+void SoftRaster::blendPolygon(const double* xs, const double* ys, int n, unsigned int color){
+	blendRows(xs,ys,n,color,0,_h-1,_scratch);
+}
+
+void SoftRaster::blendPolygon(Geom2* g, const Color& c, double alpha){
+	int n = g->size();
+	vector<double> xs, ys;
+	if(g->kind()==TG_CIRC){
+		Circ2* circ = (Circ2*)g;
+		n = Utils::ellipseSegments(circ->axisU(),circ->axisV(),(_ur[0]-_ll[0])/_w);
+		xs.resize(n);
+		ys.resize(n);
+		Utils::tessellateEllipse(circ->center(),circ->axisU(),circ->axisV(),n,&xs[0],&ys[0]);
+	}
+	else{
+		xs.resize(n);
+		ys.resize(n);
+		for(int j=0;j<n;j++){
+			xs[j] = (*g->get(j))[0];
+			ys[j] = (*g->get(j))[1];
+		}
+	}
+	unsigned int packed = GeometryBatch::packColor(c)&0xffffff;
+	packed |= ((unsigned int)(min(1.,max(0.,alpha))*255+.5))<<24;
+	blendPolygon(&xs[0],&ys[0],n,packed);
+}
+
+void SoftRaster::blendRows(const double* xs, const double* ys, int n, unsigned int color, int r0, int r1,
+	Scratch& scratch){
+	if(n<3) return;
+
+	vector<double>& px = scratch.px;
+	vector<double>& py = scratch.py;
+	vector<double>& cross = scratch.cross;
+	double miny, maxy;
+	toPixels(*this,xs,ys,n,px,py,miny,maxy);
+
+	r0 = max(r0,(int)floor(max(0.,miny)));
+	r1 = min(r1,(int)floor(min((double)_h-1,maxy)));
+
+	double alpha = ((color>>24)&0xff)/255.;
+	double src[3] = { (double)(color&0xff), (double)((color>>8)&0xff), (double)((color>>16)&0xff) };
+	vector<float>& cov = scratch.cov;
+	if((int)cov.size()<_w)
+		cov.resize(_w,0.f);
+
+	for(int r=r0;r<=r1;r++){
+		int cmin = _w, cmax = -1;
+		for(int s=0;s<SOFT_AA_SUBROWS;s++){
+			crossings(px,py,r+(s+.5)/SOFT_AA_SUBROWS,cross);
+
+			// exact horizontal coverage of every span, one subrow's share
+			for(unsigned int j=0;j+1<cross.size();j+=2){
+				double a = max(0.,cross[j]);
+				double b = min((double)_w,cross[j+1]);
+				if(a>=b) continue;
+				int ca = (int)a, cb = min(_w-1,(int)b);
+				const float w = 1.f/SOFT_AA_SUBROWS;
+				if(ca==cb){
+					cov[ca] += (float)(b-a)*w;
+				}
+				else{
+					cov[ca] += (float)(ca+1-a)*w;
+					for(int c=ca+1;c<cb;c++)
+						cov[c] += w;
+					cov[cb] += (float)(b-cb)*w;
+				}
+				cmin = min(cmin,ca);
+				cmax = max(cmax,cb);
+			}
+		}
+
+		unsigned char* row = &_rgba[4*r*_w];
+		for(int c=cmin;c<=cmax;c++){
+			double k = alpha*min(1.f,cov[c]);
+			cov[c] = 0;
+			if(k<=0) continue;
+			unsigned char* p = row+4*c;
+			for(int j=0;j<3;j++)
+				p[j] = (unsigned char)(src[j]*k+p[j]*(1-k)+.5);
+			p[3] = (unsigned char)(255*k+p[3]*(1-k)+.5);
+		}
+	}
+}
+
+void SoftRaster::drawBatch(const GeometryBatch& gb, bool smooth, WorkerPool* pool){
+	int nbands = pool ? min(_h,pool->size()*4) : 1;
+	function<void(int)> task = [&](int b){
+		int r0 = (int)((long long)_h*b/nbands);
+		int r1 = (int)((long long)_h*(b+1)/nbands)-1;
+		if(r0>r1) return;
+		// the band's window in drawing space, to skip shapes outside it
+		double yhi = _ur[1]-r0*(_ur[1]-_ll[1])/_h;
+		double ylo = _ur[1]-(r1+1)*(_ur[1]-_ll[1])/_h;
+		double pixel = (_ur[0]-_ll[0])/_w;
+		vector<double> ex, ey; // outlines of ellipses
+		Scratch scratch;
+		for(int i=0;i<gb.size();i++){
+			double b[4];
+			gb.bounds(i,b);
+			if(b[3]<ylo || b[1]>yhi || b[2]<_ll[0] || b[0]>_ur[0]) continue;
+
+			const double* xs = gb.xs()+gb.offset(i);
+			const double* ys = gb.ys()+gb.offset(i);
+			int n = gb.count(i);
+			if(gb.isEllipse(i)){
+				n = gb.outlineSize(i,pixel);
+				ex.resize(n);
+				ey.resize(n);
+				gb.outline(i,n,&ex[0],&ey[0]);
+				xs = &ex[0];
+				ys = &ey[0];
+			}
+			if(smooth)
+				blendRows(xs,ys,n,gb.packedColor(i),r0,r1,scratch);
+			else
+				fillRows(xs,ys,n,gb.packedColor(i),r0,r1,scratch);
+		}
+	};
+	if(pool)
+		pool->run(nbands,task);
+	else
+		task(0);
+}
+
+void SoftRaster::plot(const Pt2& p, unsigned int color){
+	int c = (int)floor(toPixelX(p[0]));
+	int r = (int)floor(toPixelY(p[1]));
+	if(c<0 || c>=_w || r<0 || r>=_h) return;
+
+	unsigned char* px = &_rgba[4*(r*_w+c)];
+	px[0] = color&0xff;
+	px[1] = (color>>8)&0xff;
+	px[2] = (color>>16)&0xff;
+	px[3] = (color>>24)&0xff;
+}
+
+// rgba to the bmp's bgra, one row at a time
+static void toBGRA(const unsigned char* rgba, int n, rgb_pixel_t* out){
+	for(int c=0;c<n;c++){
+		const unsigned char* p = rgba+4*c;
+		rgb_pixel_t pix = { p[2],p[1],p[0],p[3] };
+		out[c] = pix;
+	}
+}
+
+bool SoftRaster::save(const char* filename) const{
+	return bmp_save_buffer(filename,_w,_h,32,&_rgba[0],BMP_RGBA,FALSE)!=0;
+}
+
+bool saveTiled(const char* filename, int w, int h, const Pt2& ll, const Pt2& ur,
+	const Color& bg, const TileRenderer& render, WorkerPool* pool){
+	bmpstream_t* bs = bmp_stream_open(filename,w,h,24);
+	if(!bs) return false;
+
+	int ntx = (w+TILE_SIZE-1)/TILE_SIZE;
+	int nty = (h+TILE_SIZE-1)/TILE_SIZE;
+	double sx = (ur[0]-ll[0])/w;
+	double sy = (ur[1]-ll[1])/h;
+	vector<SoftRaster*> tiles(ntx,(SoftRaster*)NULL);
+	vector<rgb_pixel_t> pixels;
+	bool ok = true;
+
+	for(int ty=0;ty<nty && ok;ty++){
+		int y0 = ty*TILE_SIZE;
+		int th = min(TILE_SIZE,h-y0);
+
+		function<void(int)> task = [&](int tx){
+			int x0 = tx*TILE_SIZE;
+			int tw = min(TILE_SIZE,w-x0);
+			if(!tiles[tx] || tiles[tx]->width()!=tw || tiles[tx]->height()!=th){
+				delete tiles[tx];
+				tiles[tx] = new SoftRaster(tw,th);
+			}
+			// row 0 is the top, so tile rows go down from ur
+			SoftRaster& tile = *tiles[tx];
+			tile.clear(bg);
+			tile.setView(Pt2(ll[0]+x0*sx,ur[1]-(y0+th)*sy),Pt2(ll[0]+(x0+tw)*sx,ur[1]-y0*sy));
+			render(tile);
+		};
+		if(pool)
+			pool->run(ntx,task);
+		else
+			for(int tx=0;tx<ntx;tx++)
+				task(tx);
+
+		for(int tx=0;tx<ntx && ok;tx++){
+			const SoftRaster& tile = *tiles[tx];
+			pixels.resize(tile.width()*tile.height());
+			toBGRA(tile.data(),tile.width()*tile.height(),&pixels[0]);
+			ok = bmp_stream_write_tile(bs,tx*TILE_SIZE,y0,tile.width(),tile.height(),&pixels[0])!=0;
+		}
+	}
+
+	for(int tx=0;tx<ntx;tx++)
+		delete tiles[tx];
+	return bmp_stream_close(bs)!=0 && ok;
+}
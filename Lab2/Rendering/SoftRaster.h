@@ -0,0 +1,90 @@
+#ifndef SOFT_RASTER_H
+#define SOFT_RASTER_H
+
+// CPU rasteriser for drawing-space geometry, used where there is no
+// display or OpenGL context (e.g. the ifsrender tool).  The image covers
+// the drawing-space window [ll,ur] like gluOrtho2D does in the viewers;
+// row 0 of the pixel buffer is the top of the image.
+//
+// fillPolygon samples pixel centres and overwrites, like plain GL_POLYGON.
+// blendPolygon is the GL_POLYGON_SMOOTH look: every pixel gets the part
+// of it the polygon covers (exact along x, SOFT_AA_SUBROWS samples along
+// y) times the colour's alpha, blended over what is already there.
+
+#include "Common/TinyGeom.h"
+#include "Common/WorkerPool.h"
+#include "Rendering/GeometryBatch.h"
+#include <vector>
+#include <functional>
+
+using namespace std;
+using namespace TinyGeom;
+
+#define SOFT_AA_SUBROWS 4
+
+class SoftRaster{
+protected:
+	int _w,_h;
+	vector<unsigned char> _rgba;
+	Pt2 _ll, _ur;
+
+	double toPixelX(double x) const { return (x-_ll[0])/(_ur[0]-_ll[0])*_w; }
+	double toPixelY(double y) const { return (_ur[1]-y)/(_ur[1]-_ll[1])*_h; }
+
+	// working memory of the row functions, kept from one polygon to the
+	// next so they allocate nothing once it has grown; cov is back to all
+	// zeros after every polygon.  One per thread drawing.
+	struct Scratch{
+		vector<double> px, py, cross;
+		vector<float> cov; // coverage of a row, _w long
+	};
+	Scratch _scratch; // for the single-polygon calls
+
+	// the polygon restricted to rows [r0,r1]
+	void fillRows(const double* xs, const double* ys, int n, unsigned int color, int r0, int r1,
+		Scratch& scratch);
+	void blendRows(const double* xs, const double* ys, int n, unsigned int color, int r0, int r1,
+		Scratch& scratch);
+
+public:
+	SoftRaster(int w, int h);
+
+	int width() const { return _w; }
+	int height() const { return _h; }
+
+	void setView(const Pt2& ll, const Pt2& ur) { _ll = ll; _ur = ur; }
+	const Pt2& ll() const { return _ll; }
+	const Pt2& ur() const { return _ur; }
+	void clear(const Color& c);
+
+	// fills a polygon (even-odd rule) with a colour packed as 0xAABBGGRR
+	void fillPolygon(const double* xs, const double* ys, int n, unsigned int color);
+	// anti-aliased and alpha blended, same packing
+	void blendPolygon(const double* xs, const double* ys, int n, unsigned int color);
+	void blendPolygon(Geom2* g, const Color& c, double alpha=1);
+
+	// every shape of gb in order, blended if smooth; with a pool the image
+	// is split into bands of rows that are drawn in parallel, which gives
+	// the same pixels as drawing it in one go
+	void drawBatch(const GeometryBatch& gb, bool smooth, WorkerPool* pool=NULL);
+	// sets the pixel containing p
+	void plot(const Pt2& p, unsigned int color);
+
+	unsigned char* data() { return &_rgba[0]; }
+	const unsigned char* data() const { return &_rgba[0]; }
+
+	bool save(const char* filename) const;
+};
+
+#define TILE_SIZE 512 // pixels per side of a tile in saveTiled
+
+// draws into a tile whose view is already set to the tile's window
+typedef function<void(SoftRaster& tile)> TileRenderer;
+
+// renders a w x h image of the drawing-space window [ll,ur] tile by tile
+// and streams it to a 24 bit .bmp, so only one row of tiles is in memory
+// whatever the size; with a pool the tiles of a row are drawn in parallel
+bool saveTiled(const char* filename, int w, int h, const Pt2& ll, const Pt2& ur,
+	const Color& bg, const TileRenderer& render, WorkerPool* pool=NULL);
+
+#endif
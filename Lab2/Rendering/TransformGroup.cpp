@@ -62,7 +62,7 @@ void TransformGroup::applyTranslateCb(Fl_Widget* widget,void* userdata){
 		double ty = Str::parseDouble(string(group->_transy->value())); 
 
 		Transformation trans; 
-		trans.setAsTranslate(Vec2(tx,ty,0)); 
+		trans.setAsTranslate(Vec2(tx,ty)); 
 
 		for(list<Tri2*>::iterator i=tris.begin();i!=tris.end();i++){
 			Tri2* nt; 
@@ -73,6 +73,7 @@ void TransformGroup::applyTranslateCb(Fl_Widget* widget,void* userdata){
 			(*viewer->_tentry->getTri2Trans())[*i]->setAs3PtTransform(
 				*viewer->_tentry->getBase(),*(*i)); 
 		}
+		viewer->geomChanged(); 
 	}
 } 
 
@@ -97,6 +98,7 @@ void TransformGroup::applyRotateCb(Fl_Widget* widget,void* userdata){
 			(*viewer->_tentry->getTri2Trans())[*i]->setAs3PtTransform(
 				*viewer->_tentry->getBase(),*(*i)); 
 		}
+		viewer->geomChanged(); 
 	}
 } 
 
@@ -112,7 +114,7 @@ void TransformGroup::applyNUScaleCb(Fl_Widget* widget,void* userdata){
 		double sy = Str::parseDouble(string(group->_nuscaley->value())); 
 
 		Transformation trans; 
-		trans.setAsNUScale(Vec2(sx,sy,0),*viewer->_tentry->getTransCenter()); 
+		trans.setAsNUScale(Vec2(sx,sy),*viewer->_tentry->getTransCenter()); 
 
 		for(list<Tri2*>::iterator i=tris.begin();i!=tris.end();i++){
 			Tri2* nt; 
@@ -123,6 +125,7 @@ void TransformGroup::applyNUScaleCb(Fl_Widget* widget,void* userdata){
 			(*viewer->_tentry->getTri2Trans())[*i]->setAs3PtTransform(
 				*viewer->_tentry->getBase(),*(*i)); 
 		}
+		viewer->geomChanged(); 
 	}
 } 
 
@@ -148,6 +151,7 @@ void TransformGroup::applyScaleCb(Fl_Widget* widget,void* userdata){
 			(*viewer->_tentry->getTri2Trans())[*i]->setAs3PtTransform(
 				*viewer->_tentry->getBase(),*(*i)); 
 		}
+		viewer->geomChanged(); 
 	}
 } 
 
@@ -1,5 +1,6 @@
 #include <cmath> 
 #include "Rendering/Transformation.h" 
+#include "Common/AffineKernel.h" 
 
 void Transformation::setAsIdentity() {
 	_mat.identity();
@@ -92,3 +93,8 @@ void Transformation::setAs3PtTransform(const Tri2& src, const Tri2& dest) {
 	setAsIdentity();
 	compose3PtTransform(src, dest);
 }
+
+void Transformation::apply(const double* xs, const double* ys, int n, double* oxs, double* oys) const {
+	Affine::Map m = Affine::fromMat3(_mat);
+	Affine::applyMaps(&m, 1, xs, ys, n, &oxs, &oys);
+}
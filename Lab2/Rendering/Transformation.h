@@ -32,6 +32,8 @@ public:
 	void compose3PtTransform(const Tri2& src, const Tri2& dest);
 
 	Pt2 apply(const Pt2& p) { return p * _mat; }
+	// applies the transformation to n points held as separate x and y arrays
+	void apply(const double* xs, const double* ys, int n, double* oxs, double* oys) const;
 
 	// TODO: need to add more visits for more shapes
 	void visit(Tri2* geom, void* data) {
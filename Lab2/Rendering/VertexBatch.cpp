@@ -0,0 +1,99 @@
+#include "Rendering/VertexBatch.h"
+
+VertexBatch::VertexBatch(){
+	_origin = Pt2(0,0);
+}
+
+void VertexBatch::clear(const Pt2& origin){
+	_verts.clear();
+	_origin = origin;
+}
+
+void VertexBatch::set(Vertex& v, double x, double y, unsigned int color) const{
+	for(int j=0;j<4;j++)
+		v.rgba[j] = (unsigned char)((color>>(8*j))&0xff);
+	v.x = (float)(x-_origin[0]);
+	v.y = (float)(y-_origin[1]);
+}
+
+void VertexBatch::fan(Vertex* v, const double* xs, const double* ys, int n, unsigned int color,
+	const Affine::Map* m) const{
+	double x0 = xs[0], y0 = ys[0];
+	double px = xs[1], py = ys[1];
+	if(m){
+		x0 = m->a*xs[0]+m->c*ys[0]+m->e;
+		y0 = m->b*xs[0]+m->d*ys[0]+m->f;
+		px = m->a*xs[1]+m->c*ys[1]+m->e;
+		py = m->b*xs[1]+m->d*ys[1]+m->f;
+	}
+	for(int j=2;j<n;j++){
+		double x = xs[j], y = ys[j];
+		if(m){
+			x = m->a*xs[j]+m->c*ys[j]+m->e;
+			y = m->b*xs[j]+m->d*ys[j]+m->f;
+		}
+		set(*v++,x0,y0,color);
+		set(*v++,px,py,color);
+		set(*v++,x,y,color);
+		px = x;
+		py = y;
+	}
+}
+
+int VertexBatch::addPolygon(const double* xs, const double* ys, int n, unsigned int color,
+	const Affine::Map* m){
+	int first = size();
+	if(n<3) return first;
+	_verts.resize(first+polygonSize(n));
+	fan(&_verts[first],xs,ys,n,color,m);
+	return first;
+}
+
+void VertexBatch::setPolygon(int first, const double* xs, const double* ys, int n, unsigned int color){
+	if(n<3 || first<0 || first+polygonSize(n)>size()) return;
+	fan(&_verts[first],xs,ys,n,color,NULL);
+}
+
+void VertexBatch::addLoop(const double* xs, const double* ys, int n, unsigned int color){
+	int first = size();
+	_verts.resize(first+2*n);
+	Vertex* v = &_verts[first];
+	for(int j=0;j<n;j++){
+		int k = (j+1)%n;
+		set(*v++,xs[j],ys[j],color);
+		set(*v++,xs[k],ys[k],color);
+	}
+}
+
+void VertexBatch::addPoint(const Pt2& p, unsigned int color){
+	_verts.resize(size()+1);
+	set(_verts.back(),p[0],p[1],color);
+}
+
+int VertexBatch::draw(GLenum mode, int first, int count) const{
+	if(count<0) count = size()-first;
+	if(count<=0) return 0;
+
+	glPushMatrix();
+	glTranslated(_origin[0],_origin[1],0);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2,GL_FLOAT,sizeof(Vertex),&_verts[0].x);
+	glColorPointer(4,GL_UNSIGNED_BYTE,sizeof(Vertex),_verts[0].rgba);
+	glDrawArrays(mode,first,count);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glPopMatrix();
+	return count;
+}
+
+int VertexBatch::draw(GLenum mode, const vector<float>& xy){
+	int count = (int) xy.size()/2;
+	if(count==0) return 0;
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2,GL_FLOAT,0,&xy[0]);
+	glDrawArrays(mode,0,count);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	return count;
+}
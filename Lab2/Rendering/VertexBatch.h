@@ -0,0 +1,70 @@
+#ifndef VERTEX_BATCH_H
+#define VERTEX_BATCH_H
+
+// coloured vertices packed for glDrawArrays, so a viewer hands GL whole
+// runs of shapes in one call instead of a glBegin/glEnd per polygon.
+// Polygons are split into triangle fans (they are convex, like GL_POLYGON
+// wants them), outlines into GL_LINES segments, so any mix of shapes can
+// share one batch and one draw call.
+//
+// Vertices are floats relative to an origin given to clear(), which keeps
+// them precise when zoomed far from (0,0); draw() puts the origin back
+// with the modelview matrix.  These are plain client arrays, which every
+// GL since 1.1 has, so nothing needs an extension loader.
+
+#include <FL/gl.h>
+#include "Common/TinyGeom.h"
+#include "Common/AffineKernel.h"
+#include <vector>
+
+using namespace std;
+using namespace TinyGeom;
+
+class VertexBatch{
+public:
+	// the layout of GL_C4UB_V2F
+	struct Vertex{
+		unsigned char rgba[4];
+		float x, y;
+	};
+
+protected:
+	vector<Vertex> _verts;
+	Pt2 _origin;
+
+	void set(Vertex& v, double x, double y, unsigned int color) const;
+	// the polygonSize(n) vertices of a fan from v on
+	void fan(Vertex* v, const double* xs, const double* ys, int n, unsigned int color,
+		const Affine::Map* m) const;
+
+public:
+	VertexBatch();
+
+	// keeps the memory for the next fill
+	void clear(const Pt2& origin=Pt2(0,0));
+	int size() const { return (int) _verts.size(); }
+	const Pt2& origin() const { return _origin; }
+
+	// vertices a polygon of n corners takes
+	static int polygonSize(int n) { return n<3 ? 0 : 3*(n-2); }
+
+	// appends the fan of the convex polygon (xs[j],ys[j]), j < n, after m
+	// if given, in a packed 0xAABBGGRR colour; returns its first vertex
+	int addPolygon(const double* xs, const double* ys, int n, unsigned int color,
+		const Affine::Map* m=NULL);
+	// overwrites the polygonSize(n) vertices from first with another
+	// polygon of n corners
+	void setPolygon(int first, const double* xs, const double* ys, int n, unsigned int color);
+	// the closed outline of the polygon, as n segments
+	void addLoop(const double* xs, const double* ys, int n, unsigned int color);
+	void addPoint(const Pt2& p, unsigned int color);
+
+	// draws count vertices from first (all of them for -1) as mode and
+	// returns how many
+	int draw(GLenum mode, int first=0, int count=-1) const;
+
+	// x,y pairs without colour, in whatever colour is current
+	static int draw(GLenum mode, const vector<float>& xy);
+};
+
+#endif
@@ -0,0 +1,432 @@
+// ifsbench - times the geometry and transform core, without a display, so
+// changes to it can be compared run against run.
+//
+//   ifsbench [-f filter] [-m seconds] [-t threads] [-i ifs file [-n name]]
+//            [-o out.json]
+//
+//   -f  only run the benchmarks whose name contains filter
+//   -m  minimum measuring time per benchmark (default 0.2)
+//   -t  worker threads for the IFS generation (default 1)
+//   -i  IFS for the ifs_generate, ifs_dedup and ifs_composite benchmarks,
+//       text or .ifsb
+//       (default: a built-in Sierpinski triangle)
+//   -n  IFS in that file (default: the first one)
+//   -o  write the results here instead of to stdout
+//
+// Output is one JSON object per line: a "context" line, then per benchmark
+// its name, the iterations timed, ns_per_op, allocs_per_op and
+// alloc_bytes_per_op (operator new calls, see Common/AllocStats.h) and
+// peak_rss_kb, the process's peak resident set after it ran.
+//
+// Builds like ifsrender, plus BaseGrid, which only needs the FLTK headers
+// for its slider callback:
+//   g++ -O2 -I. -pthread ifsbench.cpp Common/Common.cpp Common/TinyGeom.cpp
+//       Common/AffineKernel.cpp Common/WorkerPool.cpp Common/AllocStats.cpp
+//       Rendering/Transformation.cpp Rendering/GeometryBatch.cpp
+//       Rendering/BaseGrid.cpp Rendering/SceneFile.cpp -o ifsbench
+
+#include "Common/Common.h"
+#include "Common/TinyGeom.h"
+#include "Common/AffineKernel.h"
+#include "Common/AllocStats.h"
+#include "Common/WorkerPool.h"
+#include "Rendering/Manager.h"
+#include "Rendering/GeometryBatch.h"
+#include "Rendering/BaseGrid.h"
+#include "Rendering/Transformation.h"
+#include "Rendering/SceneFile.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#include <intrin.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace TinyGeom;
+
+static long long peakRSSKb() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+	return (long long)(pmc.PeakWorkingSetSize / 1024);
+#else
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru)) return 0;
+#ifdef __APPLE__
+	return ru.ru_maxrss / 1024; // bytes there
+#else
+	return ru.ru_maxrss;
+#endif
+#endif
+}
+
+// keeps the optimiser from dropping the work that produced v, or from
+// hoisting it out of the timing loop
+static const volatile void* volatile escaped;
+template <class T>
+static inline void keep(T& v) {
+#ifdef _MSC_VER
+	escaped = &v;
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : "r"(&v) : "memory");
+#endif
+}
+
+class Runner {
+protected:
+	string _filter;
+	double _minTime;
+	ostream& _out;
+
+public:
+	Runner(const string& filter, double minTime, ostream& out)
+		: _filter(filter), _minTime(minTime), _out(out) {}
+
+	bool selected(const string& name) const {
+		return _filter.empty() || name.find(_filter) != string::npos;
+	}
+
+	// runs op in a loop, growing the count until it takes at least the
+	// minimum time, and reports the last run
+	template <class F>
+	void measure(const string& name, F op) {
+		if (!selected(name)) return;
+		op(); // first touch of caches and lazily built state
+
+		long long n = 1;
+		for (;;) {
+			long long a0 = AllocStats::count(), b0 = AllocStats::bytes();
+			chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+			for (long long j = 0; j < n; j++)
+				op();
+			double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+			long long allocs = AllocStats::count() - a0, bytes = AllocStats::bytes() - b0;
+
+			if (secs >= _minTime || n >= (1LL << 40)) {
+				_out << "{\"name\":\"" << name << "\",\"iters\":" << n
+					<< ",\"ns_per_op\":" << secs * 1e9 / n
+					<< ",\"allocs_per_op\":" << allocs / (double)n
+					<< ",\"alloc_bytes_per_op\":" << bytes / (double)n
+					<< ",\"peak_rss_kb\":" << peakRSSKb() << "}" << endl;
+				return;
+			}
+			// aim a little past the minimum, at most 100x more per step
+			double grow = secs > 0 ? _minTime * 1.4 / secs : 100;
+			n = max(n + 1, (long long)(n * min(grow, 100.0)));
+		}
+	}
+};
+
+static void unitBase(TransformEntry* ent) {
+	Tri2* base = ent->getBase();
+	*base->get(0) = Pt2(0, 0);
+	*base->get(1) = Pt2(1, 0);
+	*base->get(2) = Pt2(0, 1);
+}
+
+// the Sierpinski triangle on the unit base
+static void sierpinski(TransformEntry* ent) {
+	unitBase(ent);
+	ent->add(new Tri2(Pt2(0, 0), Pt2(.5, 0), Pt2(0, .5)));
+	ent->add(new Tri2(Pt2(.5, 0), Pt2(1, 0), Pt2(.5, .5)));
+	ent->add(new Tri2(Pt2(0, .5), Pt2(.5, .5), Pt2(0, 1)));
+}
+
+// k small triangles scattered over the unit base
+static void scattered(TransformEntry* ent, int k) {
+	unitBase(ent);
+	for (int j = 0; j < k; j++) {
+		double x = (j % 8) / 8.0, y = (j / 8 % 8) / 8.0;
+		ent->add(new Tri2(Pt2(x, y), Pt2(x + .1, y), Pt2(x, y + .1)));
+	}
+}
+
+// fixed pseudo-random query points in [lo,hi]^2
+static vector<Pt2> queries(int n, double lo, double hi) {
+	vector<Pt2> ret(n);
+	unsigned int s = 12345;
+	for (int j = 0; j < n; j++) {
+		s = s * 1664525u + 1013904223u;
+		double u = (s >> 8) / 16777216.0;
+		s = s * 1664525u + 1013904223u;
+		double v = (s >> 8) / 16777216.0;
+		ret[j] = Pt2(lo + u * (hi - lo), lo + v * (hi - lo));
+	}
+	return ret;
+}
+
+static int usage() {
+	cout << "usage: ifsbench [-f filter] [-m seconds] [-t threads] [-i ifs file [-n name]] "
+		"[-o out.json]" << endl;
+	return 1;
+}
+
+int main(int argc, char** argv) {
+	string filter, infile, name, outfile;
+	double minTime = .2;
+	int nthreads = 1;
+
+	for (int j = 1; j < argc; j++) {
+		string arg = argv[j];
+		if (arg == "-f" && j + 1 < argc) filter = argv[++j];
+		else if (arg == "-m" && j + 1 < argc) minTime = atof(argv[++j]);
+		else if (arg == "-t" && j + 1 < argc) nthreads = (int)Str::parseInt(argv[++j]);
+		else if (arg == "-i" && j + 1 < argc) infile = argv[++j];
+		else if (arg == "-n" && j + 1 < argc) name = argv[++j];
+		else if (arg == "-o" && j + 1 < argc) outfile = argv[++j];
+		else return usage();
+	}
+	if (minTime <= 0 || nthreads < 1) return usage();
+
+	// the IFS the generation benchmarks apply
+	TransformManager tmanager;
+	TransformEntry* ifs = NULL;
+	if (infile.empty()) {
+		name = "sierpinski";
+		ifs = tmanager.newEntry(name);
+		sierpinski(ifs);
+	}
+	else {
+		list<string> names;
+		if (SceneFile::isScene(infile.c_str())) {
+			SceneFile scene;
+			if (scene.open(infile.c_str()))
+				names = scene.readIFS(tmanager);
+		}
+		else {
+			fstream inf(infile.c_str(), ios::in);
+			names = tmanager.read(inf);
+		}
+		if (names.empty()) {
+			cout << "no IFS in " << infile << endl;
+			return 1;
+		}
+		if (name.empty()) name = names.front();
+		ifs = tmanager.getEntry(name);
+		if (!ifs || ifs->getGeoms()->empty()) {
+			cout << "no IFS named " << name << " with transformations in " << infile << endl;
+			return 1;
+		}
+	}
+
+	ofstream outf;
+	if (!outfile.empty()) {
+		outf.open(outfile.c_str(), ios::out);
+		if (!outf) {
+			cout << "cannot write " << outfile << endl;
+			return 1;
+		}
+	}
+	ostream& out = outfile.empty() ? cout : outf;
+	out << "{\"context\":{\"kernel\":\"" << Affine::kernelName() << "\",\"threads\":" << nthreads
+		<< ",\"min_time\":" << minTime << ",\"ifs\":\"" << name << "\"}}" << endl;
+
+	Runner bench(filter, minTime, out);
+
+	// Matrix<double,3>
+	{
+		Transformation r;
+		r.setAsRotate(1, Pt2(.3, .2));
+		Mat3 a = *r.getmat(), b = *r.getmat();
+		bench.measure("mat3_mul", [&]() {
+			a = a * b;
+			keep(a);
+		});
+		bench.measure("mat3_inverse", [&]() {
+			Mat3 inv = !b;
+			keep(inv);
+			keep(b);
+		});
+	}
+
+	// Transformation
+	{
+		Transformation t;
+		t.setAsIdentity();
+		Pt2 p(.3, .4);
+		bench.measure("transform_compose_translate", [&]() {
+			t.composeTranslate(Vec2(1e-9, -1e-9));
+			keep(t);
+		});
+		bench.measure("transform_compose_rotate", [&]() {
+			t.composeRotate(1, p);
+			keep(t);
+		});
+		bench.measure("transform_compose_scale", [&]() {
+			t.composeScale(1, p);
+			keep(t);
+		});
+		bench.measure("transform_compose_nuscale", [&]() {
+			t.composeNUScale(Vec2(1, 1), p);
+			keep(t);
+		});
+		Tri2 src(Pt2(0, 0), Pt2(1, 0), Pt2(0, 1)), dest(Pt2(.1, .2), Pt2(.7, .3), Pt2(.2, .9));
+		bench.measure("transform_compose_3pt", [&]() {
+			t.setAs3PtTransform(src, dest);
+			keep(t);
+		});
+		bench.measure("transform_apply_pt", [&]() {
+			p = t.apply(p);
+			keep(p);
+		});
+
+		const int n = 4096;
+		vector<double> xs(n, .5), ys(n, .5), oxs(n), oys(n);
+		ostringstream nm;
+		nm << "transform_apply_array/" << n;
+		bench.measure(nm.str(), [&]() {
+			t.apply(&xs[0], &ys[0], n, &oxs[0], &oys[0]);
+			keep(oxs[0]);
+		});
+	}
+
+	// Geom2::accept with the Transformation visitor: one new shape per call
+	{
+		Transformation t;
+		t.setAsRotate(30, Pt2(0, 0));
+		Tri2 tri(Pt2(0, 0), .5);
+		Hex2 hex(Pt2(0, 0), .5);
+		Circ2 circ(Pt2(0, 0), .5);
+		Geom2* shapes[3] = { &tri, &hex, &circ };
+		const char* names[3] = { "tri", "hex", "circ" };
+		for (int s = 0; s < 3; s++) {
+			Geom2* g = shapes[s];
+			bench.measure(string("geom2_accept/") + names[s], [&]() {
+				Geom2* ret = NULL;
+				g->accept(&t, &ret);
+				keep(ret);
+				delete ret;
+			});
+		}
+	}
+
+	// BaseGrid
+	{
+		Tri2 base(Pt2(-1, -1), Pt2(1, -1), Pt2(0, 1));
+		BaseGrid grid;
+		grid.setBase(&base);
+		int levels[3] = { 2, 5, 8 };
+		for (int l = 0; l < 3; l++) {
+			ostringstream nm;
+			nm << "basegrid_subdivide/" << levels[l];
+			bench.measure(nm.str(), [&]() {
+				grid.subdivide(levels[l]);
+			});
+		}
+
+		vector<Pt2> pts = queries(1024, -1.5, 1.5);
+		for (int l = 0; l < 3; l++) {
+			grid.subdivide(levels[l]);
+			ostringstream nm;
+			nm << "basegrid_findclosest/" << levels[l];
+			int q = 0;
+			bench.measure(nm.str(), [&]() {
+				pair<double, int> c = grid.findClosest(pts[q]);
+				keep(c);
+				q = (q + 1) & 1023;
+			});
+		}
+	}
+
+	// Utils::isPtInterior
+	{
+		Tri2 tri(Pt2(0, 0), .8);
+		Circ2 circ(Pt2(0, 0), .8);
+		vector<Pt2> pts = queries(1024, -1, 1);
+		int q = 0;
+		bench.measure("isptinterior/tri", [&]() {
+			bool in = Utils::isPtInterior(&tri, pts[q]);
+			keep(in);
+			q = (q + 1) & 1023;
+		});
+		bench.measure("isptinterior/circ", [&]() {
+			bool in = Utils::isPtInterior(&circ, pts[q]);
+			keep(in);
+			q = (q + 1) & 1023;
+		});
+	}
+
+	// TransformEntry: an add with the remove that undoes it, and a copy
+	int sizes[2] = { 4, 64 };
+	for (int s = 0; s < 2; s++) {
+		TransformEntry ent, copy;
+		scattered(&ent, sizes[s]);
+		ostringstream nm1, nm2;
+		nm1 << "entry_add_remove/" << sizes[s];
+		nm2 << "entry_set/" << sizes[s];
+		bench.measure(nm1.str(), [&]() {
+			Tri2* t = new Tri2(Pt2(.2, .2), Pt2(.4, .2), Pt2(.2, .4));
+			ent.add(t);
+			ent.remove(t);
+		});
+		bench.measure(nm2.str(), [&]() {
+			copy.set(&ent);
+		});
+	}
+
+	// end to end, the base triangle to depth d: one addImages per generation
+	// as Apply used to expand them, the same with every generation
+	// deduplicated as ifsrender -u does, and one with the depth d
+	// composites as plain ifsrender does, rebuilding them every time
+	{
+		WorkerPool pool(nthreads);
+		WorkerPool* p = nthreads > 1 ? &pool : NULL;
+		vector<Affine::Map> maps = ifs->getMaps();
+		Color fg(.5, .5, .8);
+		GeometryBatch base;
+		base.add(ifs->getBase(), fg);
+		for (int d = 1; d <= 10; d++) {
+			ostringstream nm1, nm2, nm3;
+			nm1 << "ifs_generate/" << d;
+			nm2 << "ifs_composite/" << d;
+			nm3 << "ifs_dedup/" << d;
+			bench.measure(nm1.str(), [&]() {
+				GeometryBatch* cur = new GeometryBatch(base);
+				for (int j = 0; j < d; j++) {
+					GeometryBatch* next = new GeometryBatch();
+					next->addImages(*cur, &maps[0], (int)maps.size(), p);
+					delete cur;
+					cur = next;
+				}
+				keep(*cur);
+				delete cur;
+			});
+			bench.measure(nm3.str(), [&]() {
+				GeometryBatch* cur = new GeometryBatch(base);
+				for (int j = 0; j < d; j++) {
+					GeometryBatch* next = new GeometryBatch();
+					next->addImages(*cur, &maps[0], (int)maps.size(), p);
+					delete cur;
+					cur = next;
+					cur->dedup(DEDUP_QUANTUM, DEDUP_MIN_AREA);
+				}
+				keep(*cur);
+				delete cur;
+			});
+			bench.measure(nm2.str(), [&]() {
+				ifs->dropComposites();
+				const vector<Affine::Map>& composites = ifs->getComposites(d);
+				GeometryBatch cur;
+				cur.addImages(base, &composites[0], (int)composites.size(), p);
+				keep(cur);
+			});
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,70 @@
+// ifsconvert - converts IFS files between the text format of the IFS
+// viewer's "Save File" and the binary .ifsb scene format (Rendering/SceneFile.h)
+//
+//   ifsconvert <in> <out>
+//
+// The direction follows the input: a scene file is written out as text,
+// anything else is read as text and written as a scene.  Text files have
+// no room for geometry, so a scene's shapes are left out with a warning.
+//
+// Only needs the non-GUI sources, e.g. on Linux:
+//   g++ -O2 -I. ifsconvert.cpp Common/Common.cpp Common/TinyGeom.cpp
+//       Common/AffineKernel.cpp Common/WorkerPool.cpp
+//       Rendering/Transformation.cpp Rendering/GeometryBatch.cpp
+//       Rendering/SceneFile.cpp -o ifsconvert
+
+#include "Rendering/Manager.h"
+#include "Rendering/SceneFile.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char** argv) {
+	if (argc != 3) {
+		cout << "usage: ifsconvert <in> <out>" << endl;
+		return 1;
+	}
+
+	TransformManager tmanager;
+	list<string> names;
+
+	if (SceneFile::isScene(argv[1])) {
+		SceneFile scene;
+		if (!scene.open(argv[1])) {
+			cout << argv[1] << " is not a valid scene file" << endl;
+			return 1;
+		}
+		names = scene.readIFS(tmanager);
+		if (scene.hasGeometry())
+			cout << "leaving out the " << scene.numShapes() << " shapes of " << argv[1] << endl;
+
+		fstream outf(argv[2], ios::out);
+		if (!outf) {
+			cout << "cannot write " << argv[2] << endl;
+			return 1;
+		}
+		tmanager.write(outf);
+	}
+	else {
+		fstream inf(argv[1], ios::in);
+		if (!inf) {
+			cout << "cannot open " << argv[1] << endl;
+			return 1;
+		}
+		names = tmanager.read(inf);
+		if (names.empty()) {
+			cout << "no IFS in " << argv[1] << endl;
+			return 1;
+		}
+		if (!SceneFile::write(argv[2], &tmanager, NULL)) {
+			cout << "cannot write " << argv[2] << endl;
+			return 1;
+		}
+	}
+
+	cout << names.size() << " IFS written to " << argv[2] << endl;
+	return 0;
+}
@@ -0,0 +1,264 @@
+// ifsrender - renders an IFS file written by the IFS viewer ("Save File"),
+// text or .ifsb, straight to a .bmp, without a display or OpenGL.
+//
+//   ifsrender <ifs file> <out.bmp> [-n name] [-d depth] [-c points]
+//             [-s width height] [-t threads] [-a] [-u min area]
+//
+//   -n  IFS to render (default: the first one in the file)
+//   -d  number of generations applied to the base triangle (default 6);
+//       depths whose last generation would pass 1 GB are refused
+//   -c  run the chaos game for this many points instead of generations,
+//       shading each pixel by how many points landed in it; images whose
+//       hit counts would pass 1 GB are refused
+//   -s  image size in pixels (default 1000 1000)
+//   -t  worker threads (default: IFS_THREADS or the hardware count)
+//   -a  anti-aliased edges, like GL_POLYGON_SMOOTH with blending
+//   -u  build the generations one by one, collapsing coinciding shapes and
+//       dropping those under min area after each (GeometryBatch::dedup)
+//
+// Only needs the non-GUI sources, e.g. on Linux:
+//   gcc -O2 -c Common/bmpfile.c
+//   g++ -O2 -I. -pthread ifsrender.cpp Common/Common.cpp Common/TinyGeom.cpp
+//       Common/AffineKernel.cpp Common/WorkerPool.cpp bmpfile.o
+//       Rendering/Transformation.cpp Rendering/GeometryBatch.cpp
+//       Rendering/SoftRaster.cpp Rendering/DensityHistogram.cpp
+//       Rendering/ChaosGame.cpp Rendering/SceneFile.cpp
+//       Rendering/BoundsTree.cpp -o ifsrender
+
+#include "Common/Common.h"
+#include "Common/TinyGeom.h"
+#include "Common/AffineKernel.h"
+#include "Common/WorkerPool.h"
+#include "Rendering/Manager.h"
+#include "Rendering/GeometryBatch.h"
+#include "Rendering/SoftRaster.h"
+#include "Rendering/BoundsTree.h"
+#include "Rendering/ChaosGame.h"
+#include "Rendering/SceneFile.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <climits>
+#include <cmath>
+
+using namespace std;
+using namespace TinyGeom;
+
+#define MAX_GENERATION_BYTES ((size_t)1 << 30) // largest generation built
+
+// whether a batch of nshapes shapes and nverts vertices, taken copies
+// times, still has int indices and fits MAX_GENERATION_BYTES along with
+// extra bytes; says why not if it doesn't
+static bool checkSize(double nshapes, double nverts, double copies, double extra, int depth) {
+	double shapes = nshapes * copies;
+	double verts = nverts * copies;
+	double bytes = GeometryBatch::bytes(shapes, verts) + extra;
+	if (verts <= INT_MAX && bytes <= MAX_GENERATION_BYTES)
+		return true;
+	cout << "depth " << depth << " needs " << (long long)shapes << " shapes and " << (size_t)(bytes / (1 << 20))
+		<< " MB, more than the " << (MAX_GENERATION_BYTES >> 20) << " MB ifsrender builds; "
+		"use a lower -d, or -u or -c" << endl;
+	return false;
+}
+
+static int usage() {
+	cout << "usage: ifsrender <ifs file> <out.bmp> [-n name] [-d depth] [-c points] "
+		"[-s width height] [-t threads] [-a] [-u min area]" << endl;
+	return 1;
+}
+
+// grows [ll,ur] to the aspect ratio of the image plus a small margin
+static void fitView(Pt2& ll, Pt2& ur, int w, int h) {
+	Pt2 center = (ll + ur) * .5;
+	double hw = max((ur[0] - ll[0]) * .5, 1e-9);
+	double hh = max((ur[1] - ll[1]) * .5, 1e-9);
+	if (hw / hh < w / (double)h)
+		hw = hh * w / h;
+	else
+		hh = hw * h / w;
+	hw *= 1.05;
+	hh *= 1.05;
+	ll = center - Pt2(hw, hh);
+	ur = center + Pt2(hw, hh);
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) return usage();
+
+	string infile = argv[1];
+	string outfile = argv[2];
+	string name;
+	int depth = 6;
+	long long points = 0;
+	int w = 1000, h = 1000;
+	int nthreads = WorkerPool::defaultThreads();
+	bool smooth = false;
+	double dedupArea = -1; // no dedup
+
+	for (int j = 3; j < argc; j++) {
+		string arg = argv[j];
+		if (arg == "-n" && j + 1 < argc) name = argv[++j];
+		else if (arg == "-d" && j + 1 < argc) depth = (int)Str::parseInt(argv[++j]);
+		else if (arg == "-c" && j + 1 < argc) points = atoll(argv[++j]);
+		else if (arg == "-s" && j + 2 < argc) {
+			w = (int)Str::parseInt(argv[++j]);
+			h = (int)Str::parseInt(argv[++j]);
+		}
+		else if (arg == "-t" && j + 1 < argc) nthreads = (int)Str::parseInt(argv[++j]);
+		else if (arg == "-a") smooth = true;
+		else if (arg == "-u" && j + 1 < argc) dedupArea = max(0., atof(argv[++j]));
+		else return usage();
+	}
+	if (w < 1 || h < 1 || depth < 0) return usage();
+
+	TransformManager tmanager;
+	list<string> names;
+	if (SceneFile::isScene(infile.c_str())) {
+		SceneFile scene;
+		if (scene.open(infile.c_str()))
+			names = scene.readIFS(tmanager);
+	}
+	else {
+		fstream inf(infile.c_str(), ios::in);
+		if (!inf) {
+			cout << "cannot open " << infile << endl;
+			return 1;
+		}
+		names = tmanager.read(inf);
+	}
+	if (names.empty()) {
+		cout << "no IFS in " << infile << endl;
+		return 1;
+	}
+	if (name.empty()) name = names.front();
+
+	TransformEntry* ent = tmanager.getEntry(name);
+	if (!ent) {
+		cout << "no IFS named " << name << " in " << infile << endl;
+		return 1;
+	}
+
+	vector<Affine::Map> maps = ent->getMaps();
+	if (maps.empty()) {
+		cout << name << " has no transformations" << endl;
+		return 1;
+	}
+
+	Color fg(.5, .5, .8);
+
+	if (points > 0) {
+		// chaos game: a short run finds the extent, then the points go
+		// straight into a histogram of the image
+		ChaosGame chaos(&maps[0], (int)maps.size());
+		Pt2 ll, ur;
+		if (!chaos.bounds(100000, ll, ur)) {
+			cout << name << " does not converge" << endl;
+			return 1;
+		}
+		fitView(ll, ur, w, h);
+		if (!DensityHistogram::fits(w, h, false)) {
+			cout << w << " x " << h << " needs " << (size_t)(DensityHistogram::bytes(w, h, false) / (1 << 20))
+				<< " MB of hit counts, more than the " << (DENSITY_MAX_BYTES >> 20) << " MB ifsrender makes; "
+				"use a smaller -s" << endl;
+			return 1;
+		}
+		DensityHistogram hist(w, h, ll, ur);
+		WorkerPool pool(nthreads);
+		chaos.run(hist, points, &pool);
+
+		cout << name << ": " << points << " points" << endl;
+		if (!hist.save(outfile.c_str(), fg)) {
+			cout << "cannot write " << outfile << endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	WorkerPool pool(nthreads);
+	GeometryBatch base;
+	base.add(ent->getBase(), fg);
+	GeometryBatch* cur = new GeometryBatch();
+	int collapsed = 0;
+	if (dedupArea >= 0) {
+		// each generation is deduplicated before the next one multiplies it
+		*cur = base;
+		for (int d = 0; d < depth; d++) {
+			if (!checkSize(cur->size(), cur->numVerts(), (double)maps.size(), 0, d + 1)) {
+				delete cur;
+				return 1;
+			}
+			GeometryBatch* next = new GeometryBatch();
+			next->addImages(*cur, &maps[0], (int)maps.size(), &pool);
+			delete cur;
+			cur = next;
+			collapsed += cur->dedup(DEDUP_QUANTUM, dedupArea);
+		}
+	}
+	else {
+		// every base vertex goes through one composite map per shape of the
+		// last generation instead of through depth maps in turn
+		double copies = pow((double)maps.size(), depth);
+		if (!checkSize(base.size(), base.numVerts(), copies, copies * sizeof(Affine::Map), depth)) {
+			delete cur;
+			return 1;
+		}
+		const vector<Affine::Map>& composites = ent->getComposites(depth);
+		cur->addImages(base, &composites[0], (int)composites.size(), &pool);
+	}
+
+	Pt2 ll(1e300, 1e300), ur(-1e300, -1e300);
+	for (int i = 0; i < cur->size(); i++) {
+		double b[4];
+		cur->bounds(i, b);
+		ll = Pt2(min(ll[0], b[0]), min(ll[1], b[1]));
+		ur = Pt2(max(ur[0], b[2]), max(ur[1], b[3]));
+	}
+	fitView(ll, ur, w, h);
+
+	// the image is drawn and written in tiles, so -s can go far beyond
+	// what fits in memory; each tile asks the box tree for the shapes that
+	// touch it, in drawing order.  A pixel of 0 keeps every shape a
+	// polygon rather than a dot.
+	BoundsTree tree;
+	tree.build(cur);
+	bool ok = saveTiled(outfile.c_str(), w, h, ll, ur, Color(0, 0, 0), [&](SoftRaster& tile) {
+		double pixel = (tile.ur()[0] - tile.ll()[0]) / tile.width();
+		vector<int> shapes;
+		vector<ImplicitIFS::Dot> dots;
+		tree.query(tile.ll(), tile.ur(), 0, shapes, dots);
+		vector<double> ex, ey; // outlines of ellipses
+		for (int s = 0; s < (int)shapes.size(); s++) {
+			int i = shapes[s];
+			const double* xs = cur->xs() + cur->offset(i);
+			const double* ys = cur->ys() + cur->offset(i);
+			int n = cur->count(i);
+			if (cur->isEllipse(i)) {
+				n = cur->outlineSize(i, pixel);
+				ex.resize(n);
+				ey.resize(n);
+				cur->outline(i, n, &ex[0], &ey[0]);
+				xs = &ex[0];
+				ys = &ey[0];
+			}
+			if (smooth)
+				tile.blendPolygon(xs, ys, n, cur->packedColor(i));
+			else
+				tile.fillPolygon(xs, ys, n, cur->packedColor(i));
+		}
+	}, &pool);
+
+	cout << name << ": " << cur->size() << " shapes after " << depth << " generations";
+	if (dedupArea >= 0)
+		cout << ", " << collapsed << " collapsed";
+	cout << endl;
+	delete cur;
+
+	if (!ok) {
+		cout << "cannot write " << outfile << endl;
+		return 1;
+	}
+	return 0;
+}
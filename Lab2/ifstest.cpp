@@ -0,0 +1,161 @@
+// ifstest - checks the undo history of the geometry viewer without a
+// display: that undo brings back exactly the batch that was there before,
+// whatever the history evicted to stay in its budget.
+//
+//   ifstest
+//
+// Prints one line per check and exits non-zero if any of them failed.
+// Scene files are written to and removed from the current directory.
+//
+// Only needs the non-GUI sources, e.g. on Linux:
+//   g++ -O2 -I. -pthread ifstest.cpp Common/Common.cpp Common/TinyGeom.cpp
+//       Common/AffineKernel.cpp Common/WorkerPool.cpp
+//       Rendering/Transformation.cpp Rendering/GeometryBatch.cpp
+//       Rendering/ImplicitIFS.cpp Rendering/SceneFile.cpp -o ifstest
+
+#include "Common/AffineKernel.h"
+#include "Rendering/Manager.h"
+#include "Rendering/GeometryBatch.h"
+#include "Rendering/ImplicitIFS.h"
+#include "Rendering/SceneFile.h"
+
+#include <iostream>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+using namespace TinyGeom;
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+	cout << (ok ? "ok   " : "FAIL ") << what << endl;
+	if (!ok) failures++;
+}
+
+// the maps of the Sierpinski triangle on the unit base
+static vector<Affine::Map> sierpinski() {
+	Affine::Map m = { .5, 0, 0, .5, 0, 0 };
+	vector<Affine::Map> maps(3, m);
+	maps[1].e = .5;
+	maps[2].f = .5;
+	return maps;
+}
+
+// depth levels of the Sierpinski triangle from the shape g, 3^depth shapes
+static void generate(GeometryBatch& gb, const Geom2* g, int depth) {
+	vector<Affine::Map> maps = sierpinski();
+	gb.clear();
+	gb.add(g, Color(.2, .4, .8));
+	for (int j = 0; j < depth; j++) {
+		GeometryBatch next;
+		next.addImages(gb, &maps[0], (int)maps.size());
+		gb = next;
+	}
+}
+
+static bool same(const GeometryBatch& a, const GeometryBatch& b) {
+	if (a.size() != b.size() || a.numVerts() != b.numVerts()) return false;
+	for (int i = 0; i < a.size(); i++)
+		if (a.offset(i) != b.offset(i) || a.count(i) != b.count(i) || a.kind(i) != b.kind(i)
+			|| a.packedColor(i) != b.packedColor(i))
+			return false;
+	for (int v = 0; v < a.numVerts(); v++)
+		if (a.xs()[v] != b.xs()[v] || a.ys()[v] != b.ys()[v]) return false;
+	return true;
+}
+
+// what GeometryViewer::openGeomCb does with a scene file
+static bool open(GeometryHistory& hist, const char* filename) {
+	SceneFile scene;
+	if (!scene.open(filename) || !scene.hasGeometry()) return false;
+	GeometryBatch* geoms = new GeometryBatch();
+	scene.readGeometry(*geoms);
+	hist.push(geoms);
+	return true;
+}
+
+// what GeometryViewer::undoCb does
+static void undo(GeometryHistory& hist) {
+	if (hist.size() > 1) {
+		hist.popTop();
+		if (hist.getTop() == NULL)
+			hist.pushNew();
+	}
+}
+
+int main() {
+	Tri2 tri(Pt2(0, 0), Pt2(1, 0), Pt2(0, 1));
+	Quad2 quad(Pt2(.5, .5), .5);
+	GeometryBatch large, small;
+	generate(large, &tri, 9);
+	generate(small, &quad, 2);
+
+	// open a large scene, then another under a budget the first one does
+	// not fit in: nothing above the first can rebuild it, so undo must
+	// still find it
+	{
+		const char* a = "ifstest_large.ifsb";
+		const char* b = "ifstest_small.ifsb";
+		bool written = SceneFile::write(a, NULL, &large) && SceneFile::write(b, NULL, &small);
+		check(written, "write scenes");
+
+		GeometryHistory hist;
+		hist.pushNew(); // the viewer starts from an empty batch
+		hist.setBudget(large.bytes() / 4);
+		bool opened = written && open(hist, a) && open(hist, b);
+		check(opened, "open both scenes");
+		undo(hist);
+		check(opened && hist.size() == 2 && same(*hist.getTop(), large),
+			"undo after open brings back the first scene");
+
+		remove(a);
+		remove(b);
+	}
+
+	// Applies expanded explicitly: past the budget the older generations
+	// go, and undo rebuilds each from the one below and its maps
+	{
+		Affine::Map m = { .9, 0, 0, .9, .05, .05 };
+		vector<Affine::Map> maps(1, m);
+		GeometryHistory hist;
+		hist.pushNew(); // the viewer starts from an empty batch
+		size_t budget = 3 * large.bytes();
+		hist.setBudget(budget);
+		hist.push(new GeometryBatch(large));
+		vector<GeometryBatch> made(1, large);
+		bool within = true;
+		for (int j = 0; j < 20; j++) {
+			GeometryBatch* next = new GeometryBatch();
+			next->addImages(*hist.getTop(), &maps[0], (int)maps.size());
+			made.push_back(*next);
+			hist.pushImages(next, maps);
+			within = within && hist.bytes() <= budget;
+		}
+		check(within, "repeated explicit Applies stay within the budget");
+		bool back = true;
+		for (int j = (int)made.size() - 1; j > 0; j--) {
+			undo(hist);
+			back = back && same(*hist.getTop(), made[j - 1]);
+		}
+		check(back && hist.size() == 2, "undo rebuilds every explicit Apply");
+	}
+
+	// Apply kept implicit: the batch under it can go past the budget, and
+	// undo rebuilds it from the seed the Apply kept
+	{
+		GeometryHistory hist;
+		hist.pushNew(); // the viewer starts from an empty batch
+		hist.setBudget(large.bytes() / 4);
+		*hist.pushNew() = large;
+		vector<ImplicitIFS*> parts(1, new ImplicitIFS(large));
+		parts[0]->addLevel(sierpinski());
+		hist.pushNew(parts);
+		check(hist.bytes() < 2 * large.bytes(), "the batch under an implicit Apply is evicted");
+		undo(hist);
+		check(hist.size() == 2 && same(*hist.getTop(), large),
+			"undo after an implicit Apply brings back the batch");
+	}
+
+	return failures > 0 ? 1 : 0;
+}
@@ -94,6 +94,21 @@ int main() {
 	apply->callback(IFSViewer::applyIFSCb, &viewers);
 	mainActions.end();
 
+	Button* chaos = new Button(125, 670, 80, 20, "Chaos");
+	chaos->callback(IFSViewer::chaosGameCb, &viewers);
+
+	Button* saveDensity = new Button(210, 670, 80, 20, "Save Dens.");
+	saveDensity->callback(GeometryViewer::saveDensityCb, &ov);
+
+	Button* saveGeom = new Button(320, 620, 85, 20, "Save Geom");
+	saveGeom->callback(GeometryViewer::saveGeomCb, &ov);
+
+	Button* openGeom = new Button(417, 620, 85, 20, "Open Geom");
+	openGeom->callback(GeometryViewer::openGeomCb, &ov);
+
+	Button* exportImage = new Button(320, 645, 85, 20, "Export");
+	exportImage->callback(GeometryViewer::exportTiledCb, &ov);
+
 	Button* objGrid = new Button(295, 670, 100, 20, "Grid Off");
 	objGrid->callback(GeometryViewer::toggleGridCb, &ov);
 
@@ -110,7 +125,7 @@ int main() {
 	slider->box(FL_BORDER_BOX);
 	slider->color(WIN_COLOR);
 	slider->label("Grid subdivision");
-	slider->bounds(0, 5);
+	slider->bounds(0, 10);
 	slider->step(1);
 	slider->precision(0);
 	slider->callback(BaseGrid::subdivValueCb, &tg);
@@ -137,9 +152,15 @@ int main() {
 	Button* transBase = new Button(920, 645, 100, 20, "Base Off");
 	transBase->callback(IFSViewer::toggleBaseMode, &tv);
 
+	Button* transPreview = new Button(920, 595, 100, 20, "Preview Off");
+	transPreview->callback(IFSViewer::togglePreviewCb, &viewers);
+
 	Button* transSnap = new Button(920, 620, 100, 20, "Snap On");
 	transSnap->callback(IFSViewer::toggleSnap, &tv);
 
+	Button* transDedup = new Button(920, 570, 100, 20, "Dedup Off");
+	transDedup->callback(IFSViewer::toggleDedupCb, &viewers);
+
 
 	pair<IFSViewer*, TransformGroup*> tbundle = make_pair(&tv, &tfgroup);
 	tfgroup.getTranslateBut()->callback(TransformGroup::applyTranslateCb, &tbundle);
@@ -150,5 +171,7 @@ int main() {
 	m.end();
 	m.show();
 
+	Fl::lock(); // lets the preview thread wake the event loop through Fl::awake
+
 	return Fl::run();
 }
\ No newline at end of file